@@ -0,0 +1,6 @@
+@echo off
+del /s /q build\bench\*
+set CleanupWarningDisablers=-wd4100 -wd4189 -wd4702 -wd4065
+set RaylibDependencies=opengl32.lib kernel32.lib user32.lib gdi32.lib winmm.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib
+cl -Fobuild/bench/ -Febuild/bench/ -Iinclude -std:c++20 -W4 -EHa -O2 -Oi -nologo -GR- %CleanupWarningDisablers% bench/gameobject_update.cpp raylib.lib rlImGui.lib %RaylibDependencies% -link -LIBPATH:lib
+"build/bench/gameobject_update.exe"
\ No newline at end of file
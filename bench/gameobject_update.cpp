@@ -0,0 +1,182 @@
+// Times the per frame update loop over the GameObject layout against replicas of the layouts it replaced.
+// Build and run with bench.bat. Doesn't open a window, so nothing in here may call into raylib
+// NOTE: The engine uses the MSVC only strcpy_s and _memccpy, and shadinclude.hpp gets std::remove from <algorithm> through MSVC's headers.
+// Building with gcc takes a forced include that covers those:
+//   #include <string.h>
+//   #include <algorithm>
+//   inline int strcpy_s(char* d, size_t n, const char* s) {strncpy(d, s, n); return 0;}
+//   #define _memccpy memccpy
+// g++ -std=c++20 -O2 -fpermissive -include shim.h -Iinclude bench/gameobject_update.cpp -Wl,--unresolved-symbols=ignore-all -lpthread -static
+// The unresolved symbols are raylib and imgui, which the bench never calls
+#include <stdio.h>
+#include <chrono>
+#include <unordered_map>
+#include "engine.hpp"
+
+struct BenchBody {
+    v3 position;
+    v3 velocity;
+};
+void BenchBodyUpdate(void* _body) {
+    BenchBody* body = (BenchBody*)_body;
+    body->position = body->position + body->velocity * FRAME_TIME;
+}
+void* BenchBodyCreate(MemoryPool* mp) {
+    BenchBody* body = GameObjectDataReserve<BenchBody>(mp);
+    body->velocity = {1.f, 0.5f, 0.25f};
+    return body;
+}
+
+// Layout before per type stores. Every object carried its callbacks, script variables and editor data,
+// and its data was reserved in between everything else the scene reserved
+struct LegacyGameObject {
+    GameInstanceEventFunction Update;
+    GameInstanceEventFunction Draw3d;
+    GameInstanceEventFunction DrawUi;
+    GameInstanceEventFunction Free;
+    GameInstanceEventFunction DrawImGui;
+    GameObjectScriptFunc UpdateScript;
+    std::unordered_map<std::string, i32> variableIndices;
+    struct {
+        i32 variableCount;
+        void* types;
+        void* locations;
+        MemoryPool memoryPool;
+    } variableBuffer;
+    void* data;
+    const char* objectName;
+    const char* instanceName;
+    i32 id;
+    bool visible;
+    bool active;
+};
+#define _BENCH_LEGACY_DATA_STRIDE 256
+
+// Layout of the per type store before the hot/cold split. Dense data, but editor fields in every element
+struct UnsplitGameObject {
+    GameObjectScriptFunc UpdateScript;
+    void* scriptState;
+    void* data;
+    const char* objectName;
+    const char* instanceName;
+    i32 type;
+    i32 id;
+    u32 generation;
+    bool visible;
+    bool active;
+    bool alive;
+    bool _despawnQueued;
+};
+
+#define _BENCH_FRAMES 200
+#define _BENCH_RUNS 5 // The layouts are close, so each one is run a few times and the fastest run is kept
+typedef std::chrono::steady_clock BenchClock;
+
+double BenchLegacy(i32 count, MemoryPool* mp) {
+    LegacyGameObject* objects = new LegacyGameObject[count];
+    byte* data = MemoryReserve<byte>(mp, (u64)count * _BENCH_LEGACY_DATA_STRIDE);
+    for (i32 i = 0; i < count; i++) {
+        objects[i].Update = BenchBodyUpdate;
+        objects[i].UpdateScript = nullptr;
+        objects[i].data = data + (u64)i * _BENCH_LEGACY_DATA_STRIDE;
+        objects[i].active = true;
+        objects[i].visible = true;
+    }
+    BenchClock::time_point start = BenchClock::now();
+    for (i32 f = 0; f < _BENCH_FRAMES; f++) {
+        for (i32 i = 0; i < count; i++) {
+            if (objects[i].active && objects[i].Update != nullptr) {
+                objects[i].Update(objects[i].data);
+            }
+            if (objects[i].active && objects[i].UpdateScript != nullptr) {
+                objects[i].UpdateScript(nullptr, objects[i].data, nullptr);
+            }
+        }
+    }
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+    delete[] objects;
+    return ns / ((double)_BENCH_FRAMES * count);
+}
+// NOTE: Not const so that the compiler can't inline it into one layout's loop and not the other's
+GameInstanceEventFunction benchUpdate = BenchBodyUpdate;
+
+// Runs the Update path of _GameObjectStoreUpdateRange over an array of T, so the layouts only differ in element size
+template <typename T>
+double BenchLayout(i32 count, MemoryPool* mp) {
+    T* objects = MemoryReserveAligned<T>(mp, count, CACHE_LINE_SIZE);
+    BenchBody* bodies = MemoryReserveAligned<BenchBody>(mp, count, CACHE_LINE_SIZE);
+    for (i32 i = 0; i < count; i++) {
+        objects[i].data = &bodies[i];
+        objects[i].UpdateScript = nullptr;
+        objects[i].active = true;
+        objects[i].visible = true;
+    }
+    GameInstanceEventFunction update = benchUpdate;
+    byte* data = (byte*)bodies;
+    i32 stride = (i32)sizeof(BenchBody);
+    bool scripted = true;
+    BenchClock::time_point start = BenchClock::now();
+    for (i32 f = 0; f < _BENCH_FRAMES; f++) {
+        for (i32 i = 0; i < count; i++) {
+            T* obj = &objects[i];
+            if (!obj->active) {
+                continue;
+            }
+            update(data + i * stride);
+            if (scripted && obj->UpdateScript != nullptr) {
+                obj->UpdateScript(nullptr, obj->data, obj->scriptState);
+            }
+        }
+    }
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+    return ns / ((double)_BENCH_FRAMES * count);
+}
+// Goes through the engine, so on top of the layout this measures whatever else GameObjectsUpdate does per frame
+double BenchEngine(i32 type, i32 count, MemoryPool* mp) {
+    GameObjectDefinition def = GameObjectDefinitionCreate("Bench Body", BenchBodyCreate, &mdEngine::persistentMemory);
+    def.Update = BenchBodyUpdate;
+    def.capacity = count;
+    MdEngineRegisterObject(def, type);
+    for (i32 i = 0; i < count; i++) {
+        MdEngineInstanceGameObject(type, mp);
+    }
+    BenchClock::time_point start = BenchClock::now();
+    for (i32 f = 0; f < _BENCH_FRAMES; f++) {
+        GameObjectsUpdate();
+    }
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+    GameObjectsFree();
+    return ns / ((double)_BENCH_FRAMES * count);
+}
+
+i32 main() {
+    const i32 counts[] = {1000, 10000, 100000, 1000000};
+    const i32 countCount = sizeof(counts) / sizeof(counts[0]);
+    assert(countCount <= _MD_GAME_ENGINE_OBJECT_COUNT_MAX);
+    // NOTE: The job system isn't started, so every type updates on this thread and only the layout is measured
+    // NOTE: MdEngineInit needs a window, so only the parts GameObjectsUpdate touches get set up
+    mdEngine::scratchMemory = MemoryPoolCreate(MEGABYTES(1));
+    mdEngine::persistentMemory = MemoryPoolCreate(MEGABYTES(1));
+    mdEngine::mainThreadId = std::this_thread::get_id();
+    ArenaArrayInit(&mdEngine::gameObjectDespawnQueue, &mdEngine::persistentMemory, 64);
+    EventHandlerInit(&mdEngine::eventHandler, &mdEngine::persistentMemory);
+    CoroutineSchedulerInit(&mdEngine::coroutineScheduler, &mdEngine::persistentMemory);
+    MemoryPool mp = MemoryPoolCreateVirtual(GIGABYTES(1), 0);
+    printf("sizeof: legacy %i, unsplit %i, hot %i + cold %i bytes\n",
+        (i32)sizeof(LegacyGameObject), (i32)sizeof(UnsplitGameObject), (i32)sizeof(GameObject), (i32)sizeof(GameObjectInfo));
+    printf("%10s %14s %14s %14s %14s\n", "objects", "legacy ns/obj", "unsplit ns/obj", "hot ns/obj", "engine ns/obj");
+    for (i32 i = 0; i < countCount; i++) {
+        double legacy = BenchLegacy(counts[i], &mp);
+        double unsplit = INFINITY;
+        double hot = INFINITY;
+        for (i32 r = 0; r < _BENCH_RUNS; r++) {
+            unsplit = fmin(unsplit, BenchLayout<UnsplitGameObject>(counts[i], &mp));
+            hot = fmin(hot, BenchLayout<GameObject>(counts[i], &mp));
+        }
+        double engine = BenchEngine(i, counts[i], &mp);
+        printf("%10i %14.2f %14.2f %14.2f %14.2f\n", counts[i], legacy, unsplit, hot, engine);
+        MemoryPoolClear(&mp);
+    }
+    MemoryPoolDestroy(&mp);
+    return 0;
+}
@@ -2,4 +2,5 @@ mkdir build
 cd build
 mkdir debug
 mkdir release
+mkdir bench
 cd ../
\ No newline at end of file
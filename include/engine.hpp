@@ -2,6 +2,7 @@
 #define __MD_ENGINE_H
 
 #include <cstring>
+#include <cstddef>
 #ifndef NO_FONT_AWESOME
 #define NO_FONT_AWESOME
 #endif
@@ -16,8 +17,13 @@
 #include "imgui/imgui.h"
 
 #include <vector>
-#include <unordered_map>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <xmmintrin.h>
 
 #include "typedefs.hpp"
 #include "shadinclude.hpp"
@@ -191,8 +197,10 @@ inline ShaderColor ColorToShaderColor(Color col) {
 */
 inline i32 imini(i32 a, i32 b) {return a < b ? a : b;}
 inline i64 imini(i64 a, i64 b) {return a < b ? a : b;}
+inline i32 imaxi(i32 a, i32 b) {return a > b ? a : b;}
 inline u32 uimini(u32 a, u32 b) {return a < b ? a : b;}
 inline u64 uimini(u64 a, u64 b) {return a < b ? a : b;}
+inline i32 iclampi(i32 val, i32 min, i32 max) {return val < min ? min : (val > max ? max : val);}
 inline i32 iwrapi(i32 val, i32 min, i32 max) {
     i32 range = max - min;
 	return range == 0 ? min : min + ((((val - min) % range) + range) % range);
@@ -227,11 +235,54 @@ void DrawModelTransform(Model model, mat4 transform, Color tint) {
 }
 
 #define MAX_MATERIAL_MAPS 12
-void DrawMeshInstancedOptimized(Mesh mesh, Material material, const float16 *transforms, int instances) {
+// Shader location of the packed rotation and scale of INSTANCE_FORMAT_COMPACT.
+// The position goes in SHADER_LOC_MATRIX_MODEL, where the matrix format has its first column
+#define SHADER_LOC_INSTANCE_ROTATION_SCALE (SHADER_LOC_BONE_MATRICES + 1)
+enum INSTANCE_FORMAT {
+    INSTANCE_FORMAT_MATRIX, // float16
+    INSTANCE_FORMAT_COMPACT // InstanceTransformCompact
+};
+// Yaw, then tilt around the pitch axis, then uniform scale, then translation. Decoded in lightInstanced.vs
+struct InstanceTransformCompact {
+    v3 position;
+    u16 yaw; // [0, 2pi)
+    u8 tilt; // [0, pi/2]
+    u8 scale; // Scale times 64, so 1 is exact
+};
+static_assert(sizeof(InstanceTransformCompact) == 16, "Compact instances are meant to be a quarter of a matrix");
+InstanceTransformCompact InstanceTransformCompactCreate(v3 position, float yaw, float tilt, float scale) {
+    InstanceTransformCompact it;
+    it.position = position;
+    float turns = yaw / (2.f * PI);
+    turns -= floorf(turns);
+    it.yaw = (u16)((u32)roundf(turns * 65536.f) & 0xFFFF);
+    it.tilt = (u8)roundf(Clamp(tilt / (PI * 0.5f), 0.f, 1.f) * 255.f);
+    it.scale = (u8)roundf(Clamp(scale * 64.f, 0.f, 255.f));
+    return it;
+}
+// The format follows from which attributes the shader has
+INSTANCE_FORMAT ShaderGetInstanceFormat(Shader shader) {
+    return shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE] != -1 ? INSTANCE_FORMAT_COMPACT : INSTANCE_FORMAT_MATRIX;
+}
+i32 InstanceFormatGetStride(INSTANCE_FORMAT format) {
+    return format == INSTANCE_FORMAT_COMPACT ? (i32)sizeof(InstanceTransformCompact) : (i32)sizeof(float16);
+}
+// Position and scale of an instance, for bounds
+v3 InstanceGetPosition(const void* instances, INSTANCE_FORMAT format, i32 ind, float* scale) {
+    if (format == INSTANCE_FORMAT_COMPACT) {
+        const InstanceTransformCompact* it = (const InstanceTransformCompact*)instances + ind;
+        *scale = (float)it->scale / 64.f;
+        return it->position;
+    }
+    // NOTE: Translation is in elements 12, 13 and 14 of a float16
+    const float16* transform = (const float16*)instances + ind;
+    *scale = 1.f;
+    return {transform->v[12], transform->v[13], transform->v[14]};
+}
+// NOTE: The _DrawMeshInstanced helpers are raylib's DrawMeshInstanced cut into pieces,
+// so the per call upload below and the persistent InstanceBuffer share the same state setup
+void _DrawMeshInstancedBindMaterial(Mesh mesh, Material material) {
 #if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
-    // Instancing required variables
-    unsigned int instancesVboId = 0;
-
     // Bind shader program
     rlEnableShader(material.shader.id);
 
@@ -263,44 +314,17 @@ void DrawMeshInstancedOptimized(Mesh mesh, Material material, const float16 *tra
         rlSetUniform(material.shader.locs[SHADER_LOC_COLOR_SPECULAR], values, SHADER_UNIFORM_VEC4, 1);
     }
 
-    // Get a copy of current matrices to work with,
-    // just in case stereo render is required, and we need to modify them
     // NOTE: At this point the modelview matrix just contains the view matrix (camera)
     // That's because BeginMode3D() sets it and there is no model-drawing function
     // that modifies it, all use rlPushMatrix() and rlPopMatrix()
     Matrix matModel = MatrixIdentity();
     Matrix matView = rlGetMatrixModelview();
-    Matrix matModelView = MatrixIdentity();
     Matrix matProjection = rlGetMatrixProjection();
 
     // Upload view and projection matrices (if locations available)
     if (material.shader.locs[SHADER_LOC_MATRIX_VIEW] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_VIEW], matView);
     if (material.shader.locs[SHADER_LOC_MATRIX_PROJECTION] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_PROJECTION], matProjection);
 
-    // Enable mesh VAO to attach new buffer
-    rlEnableVertexArray(mesh.vaoId);
-
-    // This could alternatively use a static VBO and either glMapBuffer() or glBufferSubData()
-    // It isn't clear which would be reliably faster in all cases and on all platforms,
-    // anecdotally glMapBuffer() seems very slow (syncs) while glBufferSubData() seems
-    // no faster, since we're transferring all the transform matrices anyway
-    instancesVboId = rlLoadVertexBuffer(transforms, instances*sizeof(float16), false);
-
-    // Instances transformation matrices are send to shader attribute location: SHADER_LOC_MATRIX_MODEL
-    for (unsigned int i = 0; i < 4; i++)
-    {
-        rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i);
-        rlSetVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 4, RL_FLOAT, 0, sizeof(Matrix), i*sizeof(Vector4));
-        rlSetVertexAttributeDivisor(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 1);
-    }
-
-    rlDisableVertexBuffer();
-    rlDisableVertexArray();
-
-    // Accumulate internal matrix transform (push/pop) and view matrix
-    // NOTE: In this case, model instance transformation must be computed in the shader
-    matModelView = MatrixMultiply(rlGetMatrixTransform(), matView);
-
     // Upload model normal matrix (if locations available)
     if (material.shader.locs[SHADER_LOC_MATRIX_NORMAL] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_NORMAL], MatrixTranspose(MatrixInvert(matModel)));
 
@@ -331,84 +355,130 @@ void DrawMeshInstancedOptimized(Mesh mesh, Material material, const float16 *tra
             rlSetUniform(material.shader.locs[SHADER_LOC_MAP_DIFFUSE + i], &i, SHADER_UNIFORM_INT, 1);
         }
     }
+#endif
+}
+// Binds the mesh vertex buffers to the shader's attribute locations, into whichever vertex array is enabled
+void _DrawMeshInstancedBindMeshAttributes(Mesh mesh, Shader shader) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    // Bind mesh VBO data: vertex position (shader-location = 0)
+    rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION]);
+    rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_POSITION], 3, RL_FLOAT, 0, 0, 0);
+    rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_POSITION]);
 
-    // Try binding vertex array objects (VAO)
-    // or use VBOs if not possible
-    if (!rlEnableVertexArray(mesh.vaoId))
-    {
-        // Bind mesh VBO data: vertex position (shader-location = 0)
-        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION]);
-        rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_POSITION], 3, RL_FLOAT, 0, 0, 0);
-        rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_POSITION]);
+    // Bind mesh VBO data: vertex texcoords (shader-location = 1)
+    rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD]);
+    rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TEXCOORD01], 2, RL_FLOAT, 0, 0, 0);
+    rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TEXCOORD01]);
 
-        // Bind mesh VBO data: vertex texcoords (shader-location = 1)
-        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD]);
-        rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD01], 2, RL_FLOAT, 0, 0, 0);
-        rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD01]);
+    if (shader.locs[SHADER_LOC_VERTEX_NORMAL] != -1)
+    {
+        // Bind mesh VBO data: vertex normals (shader-location = 2)
+        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_NORMAL], 3, RL_FLOAT, 0, 0, 0);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_NORMAL]);
+    }
 
-        if (material.shader.locs[SHADER_LOC_VERTEX_NORMAL] != -1)
+    // Bind mesh VBO data: vertex colors (shader-location = 3, if available)
+    if (shader.locs[SHADER_LOC_VERTEX_COLOR] != -1)
+    {
+        if (mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR] != 0)
         {
-            // Bind mesh VBO data: vertex normals (shader-location = 2)
-            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL]);
-            rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_NORMAL], 3, RL_FLOAT, 0, 0, 0);
-            rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_NORMAL]);
+            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR]);
+            rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_COLOR], 4, RL_UNSIGNED_BYTE, 1, 0, 0);
+            rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_COLOR]);
         }
-
-        // Bind mesh VBO data: vertex colors (shader-location = 3, if available)
-        if (material.shader.locs[SHADER_LOC_VERTEX_COLOR] != -1)
+        else
         {
-            if (mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR] != 0)
-            {
-                rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR]);
-                rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_COLOR], 4, RL_UNSIGNED_BYTE, 1, 0, 0);
-                rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_COLOR]);
-            }
-            else
-            {
-                // Set default value for unused attribute
-                // NOTE: Required when using default shader and no VAO support
-                float value[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-                rlSetVertexAttributeDefault(material.shader.locs[SHADER_LOC_VERTEX_COLOR], value, SHADER_ATTRIB_VEC4, 4);
-                rlDisableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_COLOR]);
-            }
+            // Set default value for unused attribute
+            // NOTE: Required when using default shader and no VAO support
+            float value[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            rlSetVertexAttributeDefault(shader.locs[SHADER_LOC_VERTEX_COLOR], value, SHADER_ATTRIB_VEC4, 4);
+            rlDisableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_COLOR]);
         }
+    }
 
-        // Bind mesh VBO data: vertex tangents (shader-location = 4, if available)
-        if (material.shader.locs[SHADER_LOC_VERTEX_TANGENT] != -1)
-        {
-            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TANGENT]);
-            rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TANGENT], 4, RL_FLOAT, 0, 0, 0);
-            rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TANGENT]);
-        }
+    // Bind mesh VBO data: vertex tangents (shader-location = 4, if available)
+    if (shader.locs[SHADER_LOC_VERTEX_TANGENT] != -1)
+    {
+        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TANGENT]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TANGENT], 4, RL_FLOAT, 0, 0, 0);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TANGENT]);
+    }
 
-        // Bind mesh VBO data: vertex texcoords2 (shader-location = 5, if available)
-        if (material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD02] != -1)
-        {
-            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD2]);
-            rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD02], 2, RL_FLOAT, 0, 0, 0);
-            rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD02]);
-        }
+    // Bind mesh VBO data: vertex texcoords2 (shader-location = 5, if available)
+    if (shader.locs[SHADER_LOC_VERTEX_TEXCOORD02] != -1)
+    {
+        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD2]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TEXCOORD02], 2, RL_FLOAT, 0, 0, 0);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_TEXCOORD02]);
+    }
 
 #ifdef RL_SUPPORT_MESH_GPU_SKINNING
-        // Bind mesh VBO data: vertex bone ids (shader-location = 6, if available)
-        if (material.shader.locs[SHADER_LOC_VERTEX_BONEIDS] != -1)
-        {
-            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_BONEIDS]);
-            rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_BONEIDS], 4, RL_UNSIGNED_BYTE, 0, 0, 0);
-            rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_BONEIDS]);
-        }
+    // Bind mesh VBO data: vertex bone ids (shader-location = 6, if available)
+    if (shader.locs[SHADER_LOC_VERTEX_BONEIDS] != -1)
+    {
+        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_BONEIDS]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_BONEIDS], 4, RL_UNSIGNED_BYTE, 0, 0, 0);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_BONEIDS]);
+    }
 
-        // Bind mesh VBO data: vertex bone weights (shader-location = 7, if available)
-        if (material.shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS] != -1)
-        {
-            rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_BONEWEIGHTS]);
-            rlSetVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS], 4, RL_FLOAT, 0, 0, 0);
-            rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS]);
-        }
+    // Bind mesh VBO data: vertex bone weights (shader-location = 7, if available)
+    if (shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS] != -1)
+    {
+        rlEnableVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_BONEWEIGHTS]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS], 4, RL_FLOAT, 0, 0, 0);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_VERTEX_BONEWEIGHTS]);
+    }
 #endif
 
-        if (mesh.indices != nullptr) rlEnableVertexBufferElement(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES]);
+    if (mesh.indices != nullptr) rlEnableVertexBufferElement(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES]);
+#endif
+}
+// Points the instance attributes at the currently bound instance buffer, starting at offset bytes
+void _DrawMeshInstancedSetInstanceAttributes(Shader shader, i32 offset = 0) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    if (ShaderGetInstanceFormat(shader) == INSTANCE_FORMAT_COMPACT) {
+        const i32 stride = (i32)sizeof(InstanceTransformCompact);
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL], 3, RL_FLOAT, 0, stride, offset);
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_MATRIX_MODEL], 1);
+        // Yaw bytes, tilt and scale as normalized unsigned bytes
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE]);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE], 4, RL_UNSIGNED_BYTE, 1, stride, offset + (i32)offsetof(InstanceTransformCompact, yaw));
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE], 1);
+        return;
+    }
+    // Instances transformation matrices are send to shader attribute location: SHADER_LOC_MATRIX_MODEL
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        rlEnableVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL] + i);
+        rlSetVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 4, RL_FLOAT, 0, sizeof(Matrix), offset + i*sizeof(Vector4));
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 1);
+    }
+#endif
+}
+void _DrawMeshInstancedDisableInstanceAttributes(Shader shader) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    if (ShaderGetInstanceFormat(shader) == INSTANCE_FORMAT_COMPACT) {
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_MATRIX_MODEL], 0);
+        rlDisableVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL]);
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE], 0);
+        rlDisableVertexAttribute(shader.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE]);
+        return;
+    }
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        rlSetVertexAttributeDivisor(shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 0);
+        rlDisableVertexAttribute(shader.locs[SHADER_LOC_MATRIX_MODEL] + i);
     }
+#endif
+}
+void _DrawMeshInstancedDraw(Mesh mesh, Material material, int instances) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    // Accumulate internal matrix transform (push/pop) and view matrix
+    // NOTE: In this case, model instance transformation must be computed in the shader
+    Matrix matModelView = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+    Matrix matProjection = rlGetMatrixProjection();
 
     int eyeCount = 1;
     if (rlIsStereoRenderEnabled()) eyeCount = 2;
@@ -432,7 +502,10 @@ void DrawMeshInstancedOptimized(Mesh mesh, Material material, const float16 *tra
         if (mesh.indices != nullptr) rlDrawVertexArrayElementsInstanced(0, mesh.triangleCount*3, 0, instances);
         else rlDrawVertexArrayInstanced(0, mesh.vertexCount, instances);
     }
-
+#endif
+}
+void _DrawMeshInstancedUnbind(Material material) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
     // Unbind all bound texture maps
     for (int i = 0; i < MAX_MATERIAL_MAPS; i++)
     {
@@ -456,12 +529,191 @@ void DrawMeshInstancedOptimized(Mesh mesh, Material material, const float16 *tra
 
     // Disable shader program
     rlDisableShader();
+#endif
+}
+
+// Uploads the transforms on every call. Use an InstanceBuffer for transforms that rarely change.
+// The transforms are in the format of the material's shader, see ShaderGetInstanceFormat
+void DrawMeshInstancedOptimized(Mesh mesh, Material material, const void *transforms, int instances) {
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    _DrawMeshInstancedBindMaterial(mesh, material);
+
+    // Enable mesh VAO to attach new buffer
+    rlEnableVertexArray(mesh.vaoId);
+    unsigned int instancesVboId = rlLoadVertexBuffer(transforms, instances*InstanceFormatGetStride(ShaderGetInstanceFormat(material.shader)), false);
+    _DrawMeshInstancedSetInstanceAttributes(material.shader);
+    rlDisableVertexBuffer();
+    rlDisableVertexArray();
+
+    // Try binding vertex array objects (VAO)
+    // or use VBOs if not possible
+    if (!rlEnableVertexArray(mesh.vaoId)) _DrawMeshInstancedBindMeshAttributes(mesh, material.shader);
+
+    _DrawMeshInstancedDraw(mesh, material, instances);
+    _DrawMeshInstancedUnbind(material);
 
     // Remove instance transforms buffer
     rlUnloadVertexBuffer(instancesVboId);
 #endif
 }
 
+// Vertex array that has the mesh buffers and a buffer of per instance transforms attached once at load.
+// Drawing it is one bind and one draw call. Only valid with the shader it was loaded for, since the attribute locations come from it
+struct InstanceBuffer {
+    u32 vaoId;
+    u32 vboId;
+    i32 capacity;
+    i32 stride; // Bytes per instance
+    bool _sharesVbo; // The transforms belong to another InstanceBuffer. See InstanceBufferLoadShared
+};
+InstanceBuffer _InstanceBufferLoad(Mesh mesh, Shader shader, const void* transforms, i32 capacity, bool dynamic, const InstanceBuffer* source) {
+    InstanceBuffer ib = {};
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
+    ib.vaoId = rlLoadVertexArray();
+    if (ib.vaoId == 0) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Vertex array objects aren't supported", nameof(InstanceBufferLoad)));
+        return ib;
+    }
+    ib.capacity = capacity;
+    ib.stride = InstanceFormatGetStride(ShaderGetInstanceFormat(shader));
+    rlEnableVertexArray(ib.vaoId);
+    _DrawMeshInstancedBindMeshAttributes(mesh, shader);
+    if (source != nullptr) {
+        ib.vboId = source->vboId;
+        ib._sharesVbo = true;
+        rlEnableVertexBuffer(ib.vboId);
+    } else {
+        ib.vboId = rlLoadVertexBuffer(transforms, capacity * ib.stride, dynamic);
+    }
+    _DrawMeshInstancedSetInstanceAttributes(shader);
+    // NOTE: The vertex array has to be disabled first, or unbinding the element buffer detaches it from the array
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    rlDisableVertexBufferElement();
+#endif
+    return ib;
+}
+InstanceBuffer InstanceBufferLoad(Mesh mesh, Shader shader, const void* transforms, i32 capacity, bool dynamic) {
+    return _InstanceBufferLoad(mesh, shader, transforms, capacity, dynamic, nullptr);
+}
+// Another vertex array over the transforms of source, to draw the same instances with a different mesh.
+// Updates go through source. The shader has to use the same INSTANCE_FORMAT
+InstanceBuffer InstanceBufferLoadShared(Mesh mesh, Shader shader, const InstanceBuffer* source) {
+    if (source->vboId == 0 || InstanceFormatGetStride(ShaderGetInstanceFormat(shader)) != source->stride) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Source buffer isn't loaded or has a different instance format", nameof(InstanceBufferLoadShared)));
+        return {};
+    }
+    return _InstanceBufferLoad(mesh, shader, nullptr, source->capacity, false, source);
+}
+void InstanceBufferUpdate(InstanceBuffer* ib, const void* transforms, i32 start, i32 count) {
+    assert(start >= 0 && count >= 0 && start + count <= ib->capacity);
+    if (ib->vboId == 0 || count == 0) {
+        return;
+    }
+    rlUpdateVertexBuffer(ib->vboId, (const byte*)transforms + start * ib->stride, count * ib->stride, start * ib->stride);
+}
+void InstanceBufferUnload(InstanceBuffer* ib) {
+    if (ib->vaoId != 0) {
+        rlUnloadVertexArray(ib->vaoId);
+    }
+    if (ib->vboId != 0 && !ib->_sharesVbo) {
+        rlUnloadVertexBuffer(ib->vboId);
+    }
+    *ib = {};
+}
+void DrawMeshInstanceBuffer(Mesh mesh, Material material, const InstanceBuffer* ib, int instances) {
+    assert(instances <= ib->capacity);
+    if (ib->vaoId == 0 || instances <= 0) {
+        return;
+    }
+    _DrawMeshInstancedBindMaterial(mesh, material);
+    rlEnableVertexArray(ib->vaoId);
+    _DrawMeshInstancedDraw(mesh, material, instances);
+    _DrawMeshInstancedUnbind(material);
+}
+// Draws ranges of the buffer, given as start and count pairs. One draw call per range
+// NOTE: rlgl has no base instance draws, so the instance attributes get pointed at each range instead
+void DrawMeshInstanceBufferRanges(Mesh mesh, Material material, const InstanceBuffer* ib, const i32* ranges, i32 rangeCount) {
+    if (ib->vaoId == 0 || rangeCount <= 0) {
+        return;
+    }
+    _DrawMeshInstancedBindMaterial(mesh, material);
+    rlEnableVertexArray(ib->vaoId);
+    rlEnableVertexBuffer(ib->vboId);
+    for (i32 i = 0; i < rangeCount; i++) {
+        i32 start = ranges[i * 2];
+        i32 count = ranges[i * 2 + 1];
+        assert(start >= 0 && start + count <= ib->capacity);
+        _DrawMeshInstancedSetInstanceAttributes(material.shader, start * ib->stride);
+        _DrawMeshInstancedDraw(mesh, material, count);
+    }
+    // Leave the vertex array pointing at the start of the buffer for DrawMeshInstanceBuffer
+    _DrawMeshInstancedSetInstanceAttributes(material.shader, 0);
+    _DrawMeshInstancedUnbind(material);
+}
+
+// A mesh rendered from frameCount angles around the y axis into a row of square frames.
+// Stands in for far away instances of the mesh, see lightImpostor.vs
+struct ImpostorAtlas {
+    RenderTexture2D target;
+    Mesh quad; // Unit plane that the impostor shader turns into a camera facing billboard
+    i32 frameCount;
+    float size; // World size of the square a frame covers
+    float centerY; // Height of the frames' center above the mesh origin
+};
+ImpostorAtlas ImpostorAtlasCreate(Mesh mesh, Texture texture, i32 frameCount, i32 frameSize) {
+    ImpostorAtlas atlas = {};
+    if (frameCount <= 0 || frameSize <= 0) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Frame count and size have to be positive", nameof(ImpostorAtlasCreate)));
+        return atlas;
+    }
+    BoundingBox bounds = GetMeshBoundingBox(mesh);
+    // The frames are square and have to fit the mesh at any yaw around its origin
+    float reachX = fmaxf(fabsf(bounds.min.x), fabsf(bounds.max.x));
+    float reachZ = fmaxf(fabsf(bounds.min.z), fabsf(bounds.max.z));
+    atlas.size = fmaxf(2.f * sqrtf(reachX * reachX + reachZ * reachZ), bounds.max.y - bounds.min.y);
+    atlas.centerY = (bounds.min.y + bounds.max.y) * 0.5f;
+    atlas.frameCount = frameCount;
+    atlas.target = LoadRenderTexture(frameSize * frameCount, frameSize);
+    atlas.quad = GenMeshPlane(1.f, 1.f, 1, 1);
+
+    Material material = LoadMaterialDefault();
+    material.maps[MATERIAL_MAP_ALBEDO].texture = texture;
+    const float half = atlas.size * 0.5f;
+    BeginTextureMode(atlas.target);
+    ClearBackground(BLANK);
+    for (i32 f = 0; f < frameCount; f++) {
+        // Frame f is the mesh seen from this angle, measured from +z towards +x
+        float angle = (float)f / (float)frameCount * 2.f * PI;
+        v3 target = {0.f, atlas.centerY, 0.f};
+        v3 eye = target + v3{sinf(angle), 0.f, cosf(angle)} * atlas.size;
+        rlViewport(f * frameSize, 0, frameSize, frameSize);
+        // NOTE: Same as BeginMode3D, which would take the aspect from the whole texture instead of the frame
+        rlDrawRenderBatchActive();
+        rlMatrixMode(RL_PROJECTION);
+        rlPushMatrix();
+        rlLoadIdentity();
+        rlOrtho(-half, half, -half, half, 0.01, atlas.size * 2.0);
+        rlMatrixMode(RL_MODELVIEW);
+        rlLoadIdentity();
+        rlMultMatrixf(MatrixToFloat(MatrixLookAt(eye, target, {0.f, 1.f, 0.f})));
+        rlEnableDepthTest();
+        DrawMesh(mesh, material, MatrixIdentity());
+        EndMode3D();
+    }
+    EndTextureMode();
+    // NOTE: The texture is only borrowed, so UnloadMaterial can't be used
+    RL_FREE(material.maps);
+    GenTextureMipmaps(&atlas.target.texture);
+    SetTextureFilter(atlas.target.texture, TEXTURE_FILTER_TRILINEAR);
+    return atlas;
+}
+void ImpostorAtlasUnload(ImpostorAtlas* atlas) {
+    UnloadRenderTexture(atlas->target);
+    UnloadMesh(atlas->quad);
+    *atlas = {};
+}
+
 i32 PixelformatGetStride(i32 format) {
     switch (format) {
         case PIXELFORMAT_UNCOMPRESSED_R5G6B5:
@@ -521,27 +773,240 @@ inline void DrawCrosshair(i32 x, i32 y, Color col) {
     DrawLine(x, y - 4, x, y + 4, col);
 }
 
+/*
+    Platform util
+*/
+// NOTE: windows.h clashes with raylib so the few kernel32 functions that are needed get declared by hand
+#if defined(_WIN32)
+extern "C" {
+    __declspec(dllimport) void* __stdcall VirtualAlloc(void* address, size_t size, unsigned long allocationType, unsigned long protect);
+    __declspec(dllimport) int __stdcall VirtualFree(void* address, size_t size, unsigned long freeType);
+}
+#define _MD_WIN32_MEM_COMMIT 0x00001000
+#define _MD_WIN32_MEM_RESERVE 0x00002000
+#define _MD_WIN32_MEM_DECOMMIT 0x00004000
+#define _MD_WIN32_MEM_RELEASE 0x00008000
+#define _MD_WIN32_PAGE_NOACCESS 0x01
+#define _MD_WIN32_PAGE_READWRITE 0x04
+#else
+#include <sys/mman.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Commit granularity for virtual memory. Multiple of the page size on every platform we target
+#define VIRTUAL_MEMORY_GRANULARITY (64 * 1024)
+#define VIRTUAL_MEMORY_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+inline u64 VirtualMemoryRoundUp(u64 size, u64 granularity) {
+    return (size + granularity - 1) / granularity * granularity;
+}
+// Reserves address space only. Nothing is backed by physical memory until it's committed
+void* VirtualMemoryReserve(u64 size, bool hugePages) {
+#if defined(_WIN32)
+    // NOTE: Large pages on windows need SeLockMemoryPrivilege and can't be committed lazily, so the hint is ignored
+    return VirtualAlloc(nullptr, size, _MD_WIN32_MEM_RESERVE, _MD_WIN32_PAGE_NOACCESS);
+#else
+    void* address = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (address == MAP_FAILED) {
+        return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    if (hugePages) {
+        madvise(address, size, MADV_HUGEPAGE);
+    }
+#endif
+    return address;
+#endif
+}
+// Committed memory always reads as zero the first time it's touched
+bool VirtualMemoryCommit(void* address, u64 size) {
+#if defined(_WIN32)
+    return VirtualAlloc(address, size, _MD_WIN32_MEM_COMMIT, _MD_WIN32_PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+void VirtualMemoryDecommit(void* address, u64 size) {
+#if defined(_WIN32)
+    VirtualFree(address, size, _MD_WIN32_MEM_DECOMMIT);
+#else
+    madvise(address, size, MADV_DONTNEED);
+    mprotect(address, size, PROT_NONE);
+#endif
+}
+void VirtualMemoryRelease(void* address, u64 size) {
+#if defined(_WIN32)
+    VirtualFree(address, 0, _MD_WIN32_MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+// Returns the value that was in 'destination' before the exchange
+inline u64 AtomicCompareExchangeU64(volatile u64* destination, u64 expected, u64 desired) {
+#if defined(_MSC_VER)
+    return (u64)_InterlockedCompareExchange64((volatile long long*)destination, (long long)desired, (long long)expected);
+#else
+    return __sync_val_compare_and_swap(destination, expected, desired);
+#endif
+}
+
 /*
     Engine (raylib dependency only)
 */
 // TODO: Decouple memory allocation calls.
 // TODO: Add functionality to extend the top memory location of the buffer when the same thing is requesting more memory
+// Header placed in front of every block chained onto a memory pool. Stores the state of the block that was current before it
+struct MemoryPoolBlock {
+    MemoryPoolBlock* previous;
+    void* buffer;
+    u64 location;
+    u64 size;
+    u64 committed;
+};
+enum MEMORY_POOL_FLAGS {
+    MEMORY_POOL_FLAG_VIRTUAL = 1 << 0, // First buffer is reserved address space that gets committed as the pool fills up
+    MEMORY_POOL_FLAG_HUGE_PAGES = 1 << 1,
+    MEMORY_POOL_FLAG_DECOMMIT_ON_CLEAR = 1 << 2 // Give committed pages back to the OS on clear instead of zeroing them
+};
+#define CACHE_LINE_SIZE 64
+// Subsystems that memory gets accounted to in the memory pool statistics
+enum MEMORY_TAG {
+    MEMORY_TAG_UNTAGGED,
+    MEMORY_TAG_GAME_OBJECTS,
+    MEMORY_TAG_FOREST,
+    MEMORY_TAG_HEIGHTMAP,
+    MEMORY_TAG_DIALOGUE,
+    MEMORY_TAG_COROUTINES,
+    MEMORY_TAG_COUNT
+};
+const char* memoryTagNames[MEMORY_TAG_COUNT] = {
+    "Untagged",
+    "Game objects",
+    "Forest",
+    "Heightmap",
+    "Dialogue",
+    "Coroutines"
+};
 struct MemoryPool {
     void* buffer;
     u64 location;
     u64 size;
-    u64 alignment;
+    u64 alignment; // Minimum alignment of every reservation. 0 packs reservations tightly
+    u64 blockSize; // Minimum size of blocks chained on when the pool runs out. 0 means the pool can't grow
+    u32 flags;
+    u64 _committed; // Usable bytes of the current buffer. Equal to size unless the buffer is virtual
+    MemoryPoolBlock* _block; // Current chained block. nullptr while the pool is still in its first buffer
+    // Statistics
+    const char* name;
+    i32 tag; // Tag that new reservations are accounted to
+    u64 highWaterMark;
+    u64 allocationCount;
+    u64 tagBytes[MEMORY_TAG_COUNT]; // Bytes reserved per tag that haven't been cleared or restored away
+    u64 _chainedUsed; // Bytes used in the blocks before the current one
 };
 MemoryPool MemoryPoolCreate(u64 size);
+MemoryPool MemoryPoolCreateVirtual(u64 size, u32 flags);
 MemoryPool MemoryPoolCreateInsideMemoryPool(MemoryPool* srcMp, u64 size);
-void MemoryPoolExpand(MemoryPool* mp);
+MemoryPool MemoryPoolCreateInsideMemoryPoolConcurrent(MemoryPool* srcMp, u64 size);
+void MemoryPoolExpand(MemoryPool* mp, u64 size);
+void MemoryPoolCommit(MemoryPool* mp, u64 location);
 void MemoryPoolDestroy(MemoryPool* mp);
-void* MemoryPoolReserve(MemoryPool* mp, u64 size);
+void* MemoryPoolReserve(MemoryPool* mp, u64 size, u64 alignment = 0);
+void* MemoryPoolReserveConcurrent(MemoryPool* mp, u64 size, u64 alignment = 0);
+bool MemoryPoolExtend(MemoryPool* mp, void* ptr, u64 size, u64 sizeNew);
 void MemoryPoolClear(MemoryPool* mp);
+u64 MemoryPoolGetUsed(MemoryPool* mp);
+u64 MemoryPoolGetCapacity(MemoryPool* mp);
+void MemoryPoolDrawImGui(MemoryPool* mp);
+const char* MemoryPoolGetStatsText(MemoryPool* mp);
+// Accounts every reservation from the pool to 'tag' while the scope is alive
+struct MemoryTagScope {
+    MemoryPool* memoryPool;
+    i32 tagPrevious;
+    MemoryTagScope(MemoryPool* mp, i32 tag);
+    ~MemoryTagScope();
+};
+struct MemoryPoolMarker {
+    MemoryPoolBlock* block;
+    u64 location;
+    u64 tagBytes[MEMORY_TAG_COUNT]; // Put back on restore so that the per tag statistics rewind with the pool
+};
+MemoryPoolMarker MemoryPoolGetMarker(MemoryPool* mp);
+void MemoryPoolRestore(MemoryPool* mp, MemoryPoolMarker marker, bool zero = true);
+// Gives back everything reserved from the pool while the scope was alive
+// NOTE: When 'zero' is false the released memory keeps its contents, so later reservations from the pool may not be zeroed
+struct ScratchScope {
+    MemoryPool* memoryPool;
+    MemoryPoolMarker marker;
+    bool zero;
+    ScratchScope(MemoryPool* mp, bool zero = true);
+    ~ScratchScope();
+};
 template <typename T>
 T* MemoryReserve(MemoryPool* mp);
 template <typename T>
 T* MemoryReserve(MemoryPool* mp, u64 size);
+template <typename T>
+T* MemoryReserveAligned(MemoryPool* mp, u64 size, u64 alignment);
+MemoryPool* MdEngineGetFrameMemory();
+template <typename T>
+T* FrameReserve(u64 count = 1);
+
+// Growable array inside a memory pool. Grows in place while it's the last reservation in the pool,
+// otherwise the contents get moved and the old buffer is left behind until the pool is cleared
+template <typename T>
+struct ArenaArray {
+    T* data;
+    i32 size;
+    i32 capacity;
+    MemoryPool* memoryPool;
+};
+template <typename T>
+ArenaArray<T>* ArenaArrayCreate(MemoryPool* mp, i32 capacity = 8);
+template <typename T>
+void ArenaArrayInit(ArenaArray<T>* arr, MemoryPool* mp, i32 capacity = 8);
+template <typename T>
+void ArenaArrayReserve(ArenaArray<T>* arr, i32 capacity);
+template <typename T>
+void ArenaArrayResize(ArenaArray<T>* arr, i32 size);
+template <typename T>
+void ArenaArrayClear(ArenaArray<T>* arr);
+template <typename T>
+T* ArenaArrayPushBack(ArenaArray<T>* arr, T val);
+template <typename T>
+T* ArenaArrayPushBackMany(ArenaArray<T>* arr, const T* vals, i32 count);
+template <typename T>
+T* ArenaArrayGet(ArenaArray<T>* arr, i32 ind);
+template <typename T>
+i32 ArenaArrayFind(ArenaArray<T>* arr, T val);
+template <typename T>
+void ArenaArrayErase(ArenaArray<T>* arr, i32 ind, i32 count = 1);
+template <typename T>
+void ArenaArrayEraseSwap(ArenaArray<T>* arr, i32 ind);
+
+// Fixed size pool for objects that get destroyed before their memory pool is cleared.
+// Slots live in slabs reserved from the memory pool. Freed slots go on a free list and get reused before the pool touches a new slot
+template <typename T>
+union ObjectPoolSlot {
+    ObjectPoolSlot* next;
+    alignas(T) byte data[sizeof(T)];
+};
+template <typename T>
+struct ObjectPool {
+    MemoryPool* memoryPool;
+    ObjectPoolSlot<T>* _freeList;
+    ObjectPoolSlot<T>* _slab;
+    i32 _slabUsed;
+    i32 slabCapacity;
+    i32 count;
+};
+template <typename T>
+ObjectPool<T> ObjectPoolCreate(MemoryPool* mp, i32 slabCapacity = 64);
+template <typename T>
+T* ObjectPoolAlloc(ObjectPool<T>* pool);
+template <typename T>
+void ObjectPoolFree(ObjectPool<T>* pool, T* obj);
 
 struct TextDrawingStyle {
     Color color;
@@ -594,15 +1059,22 @@ i32 StringBuilderAddString(StringBuilder* sb, const char* str);
 i32 StringBuilderAddChar(StringBuilder* sb, char chr);
 void _StringBuilderAddChar(StringBuilder* sb, char chr);
 
+// Strings are owned by the memory pool they were created in and don't need to be destroyed
 struct String {
     char* cstr;
     i32 length;
 };
-String StringCreate(char* text);
-String _StringCreate(i32 length);
-String StringSet(String str, char* text);
-String StringSubstr(String str, i32 start, i32 count);
-void StringDestroy(String str);
+// Non-owning slice of a string. Isn't null terminated, so use StringViewToCstr before passing it to raylib
+struct StringView {
+    const char* data;
+    i32 length;
+};
+String StringCreate(const char* text, MemoryPool* mp);
+String _StringCreate(i32 length, MemoryPool* mp);
+StringView StringViewCreate(String str);
+StringView StringSubstr(String str, i32 start, i32 count);
+StringView StringViewSubstr(StringView view, i32 start, i32 count);
+char* StringViewToCstr(StringView view, MemoryPool* mp);
 
 // TODO: Move this into its own file. algorithmic.hpp or something.
 struct MarchingSquaresResult {
@@ -663,13 +1135,11 @@ CollisionInformation ColliderPointCollision(Collider* collider, v2 point);
     Engine (Dependency depth 1)
 */
 struct Tween;
-struct VariableDynamicBuffer;
 struct GameObjectDefinition;
 struct GameObject;
 struct StringList;
 struct EventArgs_TypewriterLineComplete;
 struct EventArgs_DialogueOptionsSelected;
-struct TypeList;
 struct Typewriter;
 struct DialogueOptions;
 struct Heightmap;
@@ -690,22 +1160,65 @@ void TweenStart(Tween* t);
 void TweenStep(Tween* t);
 void _TweenEnd(Tween* t);
 
-// TODO: Consider creating a list that returns variable dynamic buffer entries rather than having 3 separate lists
-struct VariableDynamicBuffer {
-    i32 variableCount;
-    TypeList* types;
-    TypeList* locations;
-    MemoryPool memoryPool;
-    static constexpr i32 BUFFER_SIZE = 64; // TODO: Make buffer size not hardcoded
+// Small work stealing thread pool. Every worker owns a queue and steals from the others when it runs dry.
+// The main thread pushes jobs and helps out while it waits, so jobs must not call into raylib or ImGui
+typedef void(*JobFunction)(void* data);
+struct Job {
+    JobFunction Run;
+    void* data;
+};
+#define _MD_JOB_QUEUE_CAPACITY 256
+#define _MD_JOB_SYSTEM_WORKER_COUNT_MAX 15
+struct JobQueue {
+    std::mutex mutex;
+    Job jobs[_MD_JOB_QUEUE_CAPACITY];
+    i32 head;
+    i32 count;
 };
-VariableDynamicBuffer VariableDynamicBufferCreate(MemoryPool* mp);
-// TODO: Unify this with the TypeList types
-i32 VariableDynamicBufferPush(VariableDynamicBuffer* vdb, void* value, i32 type);
-void* VariableDynamicBufferGet(VariableDynamicBuffer* vdb, i32 index, i32 type);
-void VariableDynamicBufferSet(VariableDynamicBuffer* vdb, i32 index, i32 type, void* value);
+struct JobSystem {
+    std::thread workers[_MD_JOB_SYSTEM_WORKER_COUNT_MAX];
+    JobQueue queues[_MD_JOB_SYSTEM_WORKER_COUNT_MAX];
+    i32 workerCount;
+    i32 _pushIndex;
+    std::atomic<i32> _queued; // Pushed but not yet picked up
+    std::atomic<i32> _pending; // Pushed but not yet finished
+    std::atomic<bool> _running;
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+};
+void JobSystemInit(i32 workerCount);
+void JobSystemShutdown();
+void JobSystemPush(JobFunction run, void* data);
+void JobSystemWaitAll();
+bool _JobQueuePop(JobQueue* queue, Job* job, bool steal);
+bool _JobSystemTryRunJob(i32 queueIndex);
+void _JobSystemWorkerMain(i32 workerIndex);
 
 typedef void*(*GameInstanceCreateFunction)(MemoryPool*);
 typedef void(*GameInstanceEventFunction)(void*);
+typedef void(*GameInstanceBatchFunction)(void* data, i32 count);
+typedef void(*GameInstanceTimedFunction)(void* data, float deltaTime);
+typedef v3(*GameInstancePositionFunction)(void* data);
+// Types get drawn from the lowest draw order to the highest. Objects of the same type draw in the order they were instanced
+enum GAME_OBJECT_DRAW_ORDER {
+    GAME_OBJECT_DRAW_ORDER_BACKGROUND = -100,
+    GAME_OBJECT_DRAW_ORDER_DEFAULT = 0,
+    GAME_OBJECT_DRAW_ORDER_OVERLAY = 100
+};
+// Shared state that a type's update reads or writes besides its own instances. Types whose sets don't overlap update
+// at the same time on the job system, the rest wait for the earlier registered type they conflict with.
+// Games declare their own state from GAME_OBJECT_ACCESS_CUSTOM upwards
+enum GAME_OBJECT_ACCESS : u64 {
+    GAME_OBJECT_ACCESS_NONE = 0,
+    GAME_OBJECT_ACCESS_INPUT = 1 << 0,
+    GAME_OBJECT_ACCESS_EVENTS = 1 << 1, // Registering and unregistering listeners. Posting events doesn't need it
+    GAME_OBJECT_ACCESS_CAMERA = 1 << 2,
+    GAME_OBJECT_ACCESS_SERVICES = 1 << 3,
+    GAME_OBJECT_ACCESS_OBJECTS = 1 << 4, // Instancing, despawning and other objects' data
+    GAME_OBJECT_ACCESS_CUSTOM = 1 << 16,
+    GAME_OBJECT_ACCESS_ALL = ~0ull
+};
+#define _MD_GAME_OBJECT_STORE_CAPACITY_DEFAULT (64 * 1024) // Only address space. Pages get committed as instances are added
 struct GameObjectDefinition {
     GameInstanceCreateFunction Create;
     GameInstanceEventFunction Update;
@@ -713,49 +1226,128 @@ struct GameObjectDefinition {
     GameInstanceEventFunction DrawUi;
     GameInstanceEventFunction Free;
     GameInstanceEventFunction DrawImGui;
+    // Optional. Called once per run of consecutive active (or visible) instances instead of once per instance
+    GameInstanceBatchFunction UpdateBatch;
+    GameInstanceBatchFunction Draw3dBatch;
+    GameInstanceBatchFunction DrawUiBatch;
+    // Optional. Takes precedence over Update and UpdateBatch. Instances get updated at their GameObject::updateRate and
+    // are passed the time since their last update
+    GameInstanceTimedFunction UpdateTimed;
+    // Optional. Lets instances with GAME_OBJECT_UPDATE_RATE_AUTO update less often the further they are from the update origin
+    GameInstancePositionFunction GetPosition;
     const char* objectName;
+    i32 capacity; // Max instances of the type per scene. Reserved as address space, so it can be generous
+    i32 drawOrder;
+    u64 reads; // GAME_OBJECT_ACCESS flags
+    u64 writes;
+    bool mainThread; // Update calls into raylib, ImGui or anything else that isn't thread safe. Scripted types always run on the main thread
+    bool parallelInstances; // Instances don't touch each other, so one type can be split across several jobs
 };
 GameObjectDefinition GameObjectDefinitionCreate(const char* objectName, GameInstanceCreateFunction createFunc, MemoryPool* mp);
-typedef void (*GameObjectScriptFunc)(GameObject* obj, void* inst);
+typedef void (*GameObjectScriptFunc)(GameObject* obj, void* inst, void* state);
+// How often a type with an UpdateTimed function updates an instance. Instances with the same rate are spread evenly across frames
+enum GAME_OBJECT_UPDATE_RATE {
+    GAME_OBJECT_UPDATE_RATE_AUTO = 0, // Picked from the distance to the update origin, or every frame if the type has no position
+    GAME_OBJECT_UPDATE_RATE_EVERY_FRAME = 1,
+    GAME_OBJECT_UPDATE_RATE_EVERY_2ND_FRAME = 2,
+    GAME_OBJECT_UPDATE_RATE_EVERY_4TH_FRAME = 4,
+    GAME_OBJECT_UPDATE_RATE_EVERY_8TH_FRAME = 8
+};
+// Only what the per frame loops touch. Kept at 32 bytes so that two objects share a cache line,
+// everything else goes in GameObjectInfo
 struct GameObject {
-    GameInstanceEventFunction Update;
-    GameInstanceEventFunction Draw3d;
-    GameInstanceEventFunction DrawUi;
-    GameInstanceEventFunction Free;
-    GameInstanceEventFunction DrawImGui;
-    GameObjectScriptFunc UpdateScript;
-    std::unordered_map<std::string, i32> variableIndices;
-    VariableDynamicBuffer variableBuffer;
     void* data;
+    GameObjectScriptFunc UpdateScript;
+    void* scriptState;
+    i16 type;
+    u8 updateRate; // GAME_OBJECT_UPDATE_RATE
+    u8 _lastUpdateFrame; // Low bits of the update frame. Enough to tell how many frames passed since the last update
+    bool visible;
+    bool active;
+    bool alive;
+    bool _despawnQueued;
+};
+#define _MD_GAME_OBJECT_NAME_LENGTH 32
+// Instance names are pooled per type so that despawned objects give them back. Longer names get cut off
+struct GameObjectName {
+    char cstr[_MD_GAME_OBJECT_NAME_LENGTH];
+};
+// Bookkeeping and editor data of the object at the same index. Use through GameObjectGetInfo
+struct GameObjectInfo {
     const char* objectName;
     const char* instanceName;
+    void(*_scriptStateFree)(void* state); // Gives the script state back to the pool of its type
     i32 id;
     struct_internal i32 idCounter;
-    bool visible;
-    bool active;
+    u32 generation; // Bumped every time the slot gets recycled so that old handles stop resolving
+};
+i32 GameObjectInfo::idCounter = 100000;
+// Refers to an object without keeping a pointer to it. Resolves to nullptr once the object has been despawned
+struct GameObjectHandle {
+    i32 type;
+    i32 index;
+    u32 generation; // 0 is never a valid generation, so a zeroed handle doesn't resolve
+};
+// Every instance of one object type. The instance data sits back to back in 'data' so that the per frame loops walk it linearly.
+// Despawned slots stay in place as holes until a new instance reuses them, so data pointers don't move.
+// Each array is a virtual memory pool with room for 'capacity' instances that gets committed as the store fills up
+struct GameObjectStore {
+    byte* data;
+    GameObject* objects; // Per frame state of the instance at the same index in 'data'
+    GameObjectInfo* info; // Cold side table, parallel to 'objects'
+    i32* _freeIndices;
+    MemoryPool _dataMemory;
+    MemoryPool _objectsMemory;
+    MemoryPool _infoMemory;
+    MemoryPool _freeIndicesMemory;
+    ObjectPool<GameObjectName> _names;
+    i32 _freeCount;
+    i32 _instancingIndex;
+    i32 stride;
+    i32 count; // Used slots including holes
+    i32 capacity;
+    i32 scriptCount;
+};
+GameObject GameObjectCreate(void* data);
+GameObjectInfo GameObjectInfoCreate(ObjectPool<GameObjectName>* names, const char* objectName, const char* instanceName = "<unnamed>");
+GameObjectInfo* GameObjectGetInfo(GameObject* obj);
+GameObjectHandle GameObjectGetHandle(GameObject* obj);
+GameObject* GameObjectResolve(GameObjectHandle handle);
+void* GameObjectResolveData(GameObjectHandle handle);
+void GameObjectDespawn(GameObjectHandle handle);
+void GameObjectsDestroyDespawned();
+// Scene wide lookup of one object per type, e.g. the player's cab. Registrations expire when the scene is freed
+struct ServiceEntry {
+    void* pointer;
+    GameObjectHandle handle;
+    u32 sceneGeneration;
 };
-i32 GameObject::idCounter = 100000;
-GameObject GameObjectCreate(void* data, MemoryPool* mp, const char* objectName, const char* instanceName = "<unnamed>");
-void GameObjectAddScript(GameObject* obj, GameObjectScriptFunc initScript, GameObjectScriptFunc updateScript);
-void GameObjectsUpdate(GameObject* gameObjects, i32 gameObjectCount);
-void GameObjectsDraw3d(GameObject* gameObjects, i32 gameObjectCount);
-void GameObjectsDrawUi(GameObject* gameObjects, i32 gameObjectCount);
-void GameObjectsFree(GameObject* gameObjects, i32 gameObjectCount);
-void GameObjectsDrawImGui(GameObject* gameObjects, i32 gameObjectCount);
-void InstanceVariablePush(std::string name, i32 value);
-void InstanceVariablePush(std::string name, byte value);
-void InstanceVariablePush(std::string name, void* value);
-void InstanceVariablePush(std::string name, float value);
-void InstanceVariablePush(std::string name, Tween value);
-template <typename T> T InstanceVariableGet(std::string name);
-void InstanceVariableSet(std::string name, i32 value);
-void InstanceVariableSet(std::string name, byte value);
-void InstanceVariableSet(std::string name, void* value);
-void InstanceVariableSet(std::string name, float value);
-void InstanceVariableSet(std::string name, Tween value);
-void _InstanceVariablePush(std::string name, i32 type, void* value);
-void* _InstanceVariableGet(std::string name, i32 type);
-void _InstanceVariableSet(std::string name, i32 type, void* value);
+template <typename T>
+void ServiceRegister(T* service);
+template <typename T>
+void ServiceRegisterObject(GameObject* obj);
+template <typename T>
+T* ServiceGet();
+template <typename T>
+ServiceEntry* _ServiceGetEntry();
+template <typename T>
+T* GameObjectDataReserve(MemoryPool* mp);
+void* _GameObjectStoreArrayInit(MemoryPool* mp, i32 capacity, u64 elementSize);
+template <typename State, typename T>
+void GameObjectAddScript(GameObject* obj, void(*initScript)(GameObject*, T*, State*), void(*updateScript)(GameObject*, T*, State*));
+void _GameObjectAddScript(GameObject* obj, void* state, GameObjectScriptFunc initScript, GameObjectScriptFunc updateScript);
+template <typename State>
+ObjectPool<State>* _GameObjectGetScriptStatePool();
+template <typename State>
+void _GameObjectScriptStateFree(void* state);
+void _GameObjectFreePooled(GameObjectStore* store, i32 index);
+void GameObjectsSetUpdateOrigin(v3 origin);
+i32 _GameObjectGetUpdateRateForDistance(float distanceSqr);
+void GameObjectsUpdate();
+void GameObjectsDraw3d();
+void GameObjectsDrawUi();
+void GameObjectsFree();
+void GameObjectsDrawImGui();
 
 struct StringList {
     String* data;
@@ -773,54 +1365,175 @@ enum EVENT_HANDLER_EVENTS {
     EVENT_DIALOGUE_OPTIONS_SELECTED,
     EVENT_COUNT
 };
+// Every event has its own args struct that names the event it belongs to
 struct EventArgs_TypewriterLineComplete {
+    struct_internal constexpr i32 eventIndex = EVENT_TYPEWRITER_LINE_COMPLETE;
     i32 lineCurrent;
     i32 lineCount;
 };
-typedef void(*EventCallbackSignature_TypewriterLineComplete)(void*, EventArgs_TypewriterLineComplete*);
 struct EventArgs_DialogueOptionsSelected {
+    struct_internal constexpr i32 eventIndex = EVENT_DIALOGUE_OPTIONS_SELECTED;
     i32 index;
     i32 count;
 };
-typedef void(*EventCallbackSignature_DialogueOptionsSelected)(void*, EventArgs_DialogueOptionsSelected*);
+const i32 eventArgsSizes[EVENT_COUNT] = {
+    sizeof(EventArgs_TypewriterLineComplete),
+    sizeof(EventArgs_DialogueOptionsSelected)
+};
+#define _MD_EVENT_ARGS_SIZE_MAX 32
+#define _MD_EVENT_QUEUE_CAPACITY 64
+#define _MD_EVENT_THREAD_QUEUE_CAPACITY 256 // Power of two
+#define _MD_EVENT_FLUSH_PASSES_MAX 4
+struct EventListener {
+    void* registrar;
+    void* sender; // Only events posted by this sender reach the listener. nullptr listens to every sender
+    EventCallbackSignature callback;
+    i32 _slot;
+};
+// Stays valid until it's unregistered, even while other listeners of the event come and go
+struct EventListenerHandle {
+    i32 ind;
+    i32 slot;
+    u32 generation; // 0 is never valid, so a zeroed handle can be unregistered safely
+};
+struct _EventListenerSlot {
+    i32 listenerIndex;
+    u32 generation;
+};
+// Posted events of one type, waiting for the next flush
+struct EventQueue {
+    byte* args;
+    void** senders;
+    i32 head;
+    i32 count;
+};
+// Bounded lock free queue that any thread can post to and only the main thread takes from
+struct _EventThreadQueueSlot {
+    std::atomic<u32> sequence;
+    i32 ind;
+    void* sender;
+    alignas(8) byte args[_MD_EVENT_ARGS_SIZE_MAX];
+};
+// The writer and reader state sit on cache lines of their own. They're padded out by hand,
+// since MSVC warns about structs that get padded because of alignas (C4324)
+struct alignas(CACHE_LINE_SIZE) _EventThreadQueueWriter {
+    std::atomic<u32> index;
+    std::atomic<i32> droppedCount; // Posts that found the queue full. Reported by EventHandlerFlush, since TraceLog isn't thread safe
+    byte _padding[CACHE_LINE_SIZE - sizeof(std::atomic<u32>) - sizeof(std::atomic<i32>)];
+};
+struct alignas(CACHE_LINE_SIZE) _EventThreadQueueReader {
+    u32 index;
+    byte _padding[CACHE_LINE_SIZE - sizeof(u32)];
+};
+struct _EventThreadQueue {
+    _EventThreadQueueWriter writer;
+    _EventThreadQueueReader reader;
+    _EventThreadQueueSlot slots[_MD_EVENT_THREAD_QUEUE_CAPACITY];
+};
+static_assert(sizeof(_EventThreadQueue) == 2 * CACHE_LINE_SIZE + sizeof(_EventThreadQueueSlot) * _MD_EVENT_THREAD_QUEUE_CAPACITY, "Event thread queue shouldn't need padding");
+// Events are posted during the update and dispatched together in EventHandlerFlush, one event type at a time.
+// Listeners get removed by swapping in the last one, so the order they get called in isn't kept
 struct EventHandler {
-    TypeList* callbacks[EVENT_COUNT];
-    TypeList* registrars[EVENT_COUNT];
+    ArenaArray<EventListener> listeners[EVENT_COUNT];
+    ArenaArray<_EventListenerSlot> slots[EVENT_COUNT];
+    ArenaArray<i32> freeSlots[EVENT_COUNT];
+    EventQueue queues[EVENT_COUNT];
+    _EventThreadQueue* threadQueue;
+    ArenaArray<EventListenerHandle> _unregisterQueue; // Unregistrations made while dispatching
+    bool _dispatching;
+};
+void EventHandlerInit(EventHandler* eh, MemoryPool* mp);
+EventListenerHandle EventHandlerRegisterEvent(i32 ind, void* registrar, EventCallbackSignature callback, void* sender = nullptr);
+template <typename R, typename T>
+EventListenerHandle EventHandlerRegister(R* registrar, void(*callback)(R*, T*), void* sender = nullptr);
+void EventHandlerUnregisterEvent(EventListenerHandle handle);
+void _EventHandlerRemoveListener(EventListenerHandle handle);
+template <typename T>
+void EventHandlerPost(void* sender, T args);
+void EventHandlerPostEvent(void* sender, i32 ind, void* args);
+bool _EventQueuePush(EventQueue* queue, i32 ind, void* sender, void* args);
+bool _EventThreadQueuePush(_EventThreadQueue* queue, i32 ind, void* sender, void* args);
+bool _EventThreadQueuePop(_EventThreadQueue* queue, i32* ind, void** sender, void* args);
+void EventHandlerFlush();
+void EventHandlerClearQueues();
+
+// Scripts that read top to bottom and sleep in between, e.g. co_await WaitSeconds(2.f).
+// Sleeping coroutines aren't touched until they're due. They resume on the main thread after the objects have updated
+struct CoroutinePromise;
+struct Coroutine {
+    typedef CoroutinePromise promise_type;
+    std::coroutine_handle<CoroutinePromise> handle;
+};
+// NOTE: Frames come from pools in scene memory, so a coroutine must not outlive the scene that started it.
+// Despawning the owner destroys its waiting coroutines and gives their frames back
+struct CoroutinePromise {
+    GameObjectHandle owner;
+    Coroutine get_return_object() {return {std::coroutine_handle<CoroutinePromise>::from_promise(*this)};}
+    std::suspend_always initial_suspend() noexcept {return {};}
+    std::suspend_never final_suspend() noexcept {return {};}
+    void return_void() {}
+    void unhandled_exception() {assert(false);}
+    void* operator new(size_t size);
+    void operator delete(void* ptr, size_t size);
 };
-EventHandler EventHandlerCreate();
-void EventHandlerRegisterEvent(i32 ind, void* registrar, EventCallbackSignature callback);
-void EventHandlerUnregisterEvent(i32 ind, void* registrar);
-void EventHandlerCallEvent(void* caller, i32 ind, void* args);
+struct WaitSeconds {
+    float seconds;
+    WaitSeconds(float seconds) : seconds(seconds) {}
+    bool await_ready() {return false;}
+    void await_suspend(std::coroutine_handle<CoroutinePromise> handle);
+    void await_resume() {}
+};
+// Resumes on the next update. For scripts that have to do something every frame
+struct NextFrame {
+    bool await_ready() {return false;}
+    void await_suspend(std::coroutine_handle<CoroutinePromise> handle);
+    void await_resume() {}
+};
+// Resumes right after the event has been dispatched. Event args aren't passed on, they only live during the dispatch
+struct Event {
+    i32 ind;
+    Event(i32 ind) : ind(ind) {}
+    bool await_ready() {return false;}
+    void await_suspend(std::coroutine_handle<CoroutinePromise> handle);
+    void await_resume() {}
+};
+struct _CoroutineWaiter {
+    std::coroutine_handle<CoroutinePromise> handle;
+    u64 wakeFrame;
+    u64 order; // Breaks ties between waiters that wake up on the same frame so that they resume in the order they went to sleep
+};
+#define _MD_COROUTINE_FRAME_SIZE_SMALL 256
+#define _MD_COROUTINE_FRAME_SIZE_MEDIUM 1024
+#define _MD_COROUTINE_FRAME_SIZE_LARGE 4096
+template <i32 Size>
+struct _CoroutineFrame {
+    alignas(std::max_align_t) byte data[Size];
+};
+struct CoroutineScheduler {
+    ArenaArray<_CoroutineWaiter> sleeping; // Min heap on wakeFrame
+    ArenaArray<_CoroutineWaiter> eventWaiting[EVENT_COUNT];
+    ArenaArray<_CoroutineWaiter> _resuming;
+    bool eventCalled[EVENT_COUNT]; // Set by EventHandlerFlush, so only ever touched on the main thread
+    u64 frame;
+    u64 _order;
+    // Frames by size class. Bigger frames are reserved from scene memory and only go away with the scene
+    ObjectPool<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_SMALL>> _framesSmall;
+    ObjectPool<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_MEDIUM>> _framesMedium;
+    ObjectPool<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_LARGE>> _framesLarge;
+};
+void CoroutineSchedulerInit(CoroutineScheduler* cs, MemoryPool* mp);
+void _CoroutineSchedulerResetFrames(CoroutineScheduler* cs);
+template <typename T>
+void GameObjectStartCoroutine(GameObject* obj, Coroutine(*script)(GameObject*, T*));
+void _GameObjectStartCoroutine(GameObject* obj, Coroutine co);
+void CoroutinesUpdate();
+void CoroutinesClear();
+void CoroutinesDestroyOrphaned();
+bool _CoroutineWaitersDestroyOrphaned(ArenaArray<_CoroutineWaiter>* waiters);
+void _CoroutineSleep(std::coroutine_handle<CoroutinePromise> handle, u64 frames);
+void _CoroutineSleepingSiftDown(ArenaArray<_CoroutineWaiter>* heap, i32 i, _CoroutineWaiter waiter);
+bool _CoroutineWaiterBefore(_CoroutineWaiter a, _CoroutineWaiter b);
 
-// TODO: Support U64
-struct TypeList {
-    void* buffer;
-    MemoryPool* memoryProvider;
-    i32 bufferStride;
-    i32 size;
-    i32 capacity;
-    i32 typeIndex;
-};
-TypeList* TypeListCreate(i32 typeIndex, MemoryPool* memoryPool, i32 capacity = 5);
-void TypeListSetCapacity(TypeList* list, i32 capacity);
-void TypeListGrowCapacityIfLimitReached(TypeList* list);
-void TypeListResize(TypeList* list, i32 size);
-void TypeListPushBackI32(TypeList* list, i32 val);
-i32 TypeListGetI32(TypeList* list, i32 ind);
-void TypeListSetI32(TypeList* list, i32 ind, i32 val);
-i32 TypeListFindI32(TypeList* list, i32 val);
-void TypeListPushBackPtr(TypeList* list, void* val);
-void* TypeListGetPtr(TypeList* list, i32 ind);
-void TypeListSetPtr(TypeList* list, i32 ind, void* val);
-i32 TypeListFindPtr(TypeList* list, void* val);
-void _TypeListPushBackPtr(TypeList* list, void* val);
-void* _TypeListGetPtr(TypeList* list, i32 ind);
-void _TypeListSetPtr(TypeList* list, i32 ind, void* val);
-i32 _TypeListFindPtr(TypeList* list, void* val);
-void TypeListPushBackGameObjectDefinition(TypeList* list, GameObjectDefinition val);
-GameObjectDefinition* TypeListGetGameObjectDefinition(TypeList* list, i32 ind);
-void TypeListSetGameObjectDefinition(TypeList* list, i32 ind, GameObjectDefinition val);
-i32 TypeListFindGameObjectDefinition(TypeList* list, GameObject* val);
 
 struct Typewriter {
     String *text;
@@ -870,6 +1583,7 @@ struct HeightmapGenerationInfo {
     v3 position;
     v3 size;
     i32 resdiv;
+    MemoryPool* memoryPool; // Height data gets malloc'd when this isn't set
 };
 struct Heightmap {
     v3 position;
@@ -878,19 +1592,94 @@ struct Heightmap {
     i32 heightDataHeight;
     float *heightData;
     i32 width;
+    MemoryPool* _memoryPool;
 };
 void HeightmapInit(Heightmap* hm, HeightmapGenerationInfo info);
 float HeightmapSampleHeight(Heightmap* heightmap, float x, float z);
 void HeightmapFree(Heightmap* hm);
 
+// Instances bucketed into grid cells on the XZ plane. The transforms are sorted by cell, so every cell is one range
+// of the instance buffer. Bounds are kept as structure of arrays and padded to a multiple of 4 to be culled 4 at a time
+struct InstanceChunkGrid {
+    float* centerX;
+    float* centerY;
+    float* centerZ;
+    float* extentX;
+    float* extentY;
+    float* extentZ;
+    i32* starts;
+    i32* counts;
+    i32 count; // Only cells with instances in them are kept
+    i32* _visibleRanges; // Start and count pairs of adjacent visible cells that get the mesh
+    i32 _visibleRangeCount;
+    i32* _impostorRanges; // Same for the visible cells that get the impostor
+    i32 _impostorRangeCount;
+    mat4 _cullMatrix; // View projection the visible ranges were culled with
+    bool _cullValid;
+};
+void _InstanceChunkGridCull(InstanceChunkGrid* grid, mat4 viewProjection, v3 origin, float meshDistance, float impostorDistance);
+
+struct _InstanceLodLocations {
+    i32 origin;
+    i32 fadeStart;
+    i32 fadeEnd;
+};
 struct InstanceRenderer {
-    float16 *transforms;
+    void *transforms; // In the material shader's INSTANCE_FORMAT. NOTE: Call InstanceRendererMarkDirty after editing these, they're only uploaded once
     i32 instanceCount;
     Mesh mesh;
     Material* material;
+    InstanceChunkGrid chunks; // Everything is drawn when there aren't any. See InstanceRendererBuildChunks
+    ImpostorAtlas* impostor; // Drawn instead of the mesh for far instances when set. See InstanceRendererSetImpostor
+    Material* impostorMaterial;
+    float impostorDistance; // The crossfade from the mesh to the impostor ends here
+    float impostorFade; // Length of the crossfade
+    InstanceBuffer _buffer;
+    InstanceBuffer _impostorBuffer;
+    // Uniform locations, looked up by InstanceRendererSetImpostor. The uniforms are only set while there's an impostor
+    _InstanceLodLocations _meshLodLocs;
+    _InstanceLodLocations _impostorLodLocs;
+    i32 _impostorFramesLoc;
+    i32 _impostorSizeLoc;
+    i32 _impostorCenterYLoc;
+    i32 _dirtyStart;
+    i32 _dirtyEnd;
+};
+#define _MD_INSTANCE_STREAM_CAPACITY (4096 * (i32)sizeof(float16)) // Bytes per flush
+#define _MD_INSTANCE_STREAM_REGIONS 3
+#define _MD_INSTANCE_STREAM_DRAWS_MAX 128
+struct _InstanceStreamDraw {
+    Mesh mesh;
+    Material material;
+    i32 offset; // In bytes from the start of the region
+    i32 count;
 };
+// One vertex buffer shared by every instanced draw whose transforms change each frame.
+// Draws are queued, then InstanceStreamFlush uploads all of their transforms at once and draws them.
+// NOTE: rlgl exposes neither fences nor buffer mapping. Flushes write to the buffer's regions round robin instead,
+// so an upload doesn't land on a region that a draw from the last couple of flushes may still be reading
+struct InstanceStream {
+    byte* staging;
+    _InstanceStreamDraw* draws;
+    u32 vboId;
+    i32 region;
+    i32 size; // Bytes queued since the last flush
+    i32 drawCount;
+};
+void InstanceStreamInit(InstanceStream* is, MemoryPool* mp);
+void* InstanceStreamQueueDraw(InstanceStream* is, Mesh mesh, Material material, i32 instances);
+void InstanceStreamFlush(InstanceStream* is);
+void DrawMeshInstancedStreamed(Mesh mesh, Material material, const void* transforms, i32 instances);
+
 void* InstanceRendererCreate(MemoryPool* mp);
+void InstanceRendererUpload(InstanceRenderer* ir);
+void InstanceRendererMarkDirty(InstanceRenderer* ir, i32 start, i32 count);
+void InstanceRendererBuildChunks(InstanceRenderer* ir, float chunkSize, MemoryPool* mp);
+void InstanceRendererSetImpostor(InstanceRenderer* ir, ImpostorAtlas* atlas, Material* material, float distance, float fade);
+_InstanceLodLocations _InstanceLodLocationsGet(Shader shader);
+void _InstanceRendererSetLodUniforms(Shader shader, _InstanceLodLocations locs, v3 origin, float fadeStart, float fadeEnd);
 void InstanceRendererDraw3d(InstanceRenderer* is);
+void InstanceRendererFree(InstanceRenderer* ir);
 
 /*
     Game Objects
@@ -907,12 +1696,15 @@ struct Skybox;
 struct DialogueSequence {
     Typewriter typewriter;
     DialogueOptions options;
-    TypeList* sections;
+    ArenaArray<DialogueSequenceSection*>* sections;
+    EventListenerHandle _lineCompleteListener;
+    EventListenerHandle _optionSelectedListener;
     i32 sectionIndex;
     bool active;
 };
 void* DialogueSequenceCreate(MemoryPool* mp);
 void DialogueSequenceUpdate(DialogueSequence* dseq);
+void DialogueSequenceFree(DialogueSequence* dseq);
 void DialogueSequenceDrawUi(DialogueSequence* dseq);
 enum DIALOGUE_SEQUENCE_LAYOUT {
     DIALOGUE_SEQUENCE_LAYOUT_PLACEHOLDER,
@@ -925,7 +1717,7 @@ void DialogueSequenceHandleOptions_Selected(DialogueSequence* dseq, EventArgs_Di
 struct DialogueSequenceSection {
     StringList* text;
     StringList* options;
-    TypeList* link;
+    ArenaArray<i32>* link;
 };
 void DialogueSequenceSectionStart(DialogueSequence* dseq, i32 ind);
 DialogueSequenceSection* DialogueSequenceSectionGet(DialogueSequence* dseq, i32 ind);
@@ -938,6 +1730,7 @@ struct ModelInstance {
 };
 void* ModelInstanceCreate(MemoryPool* mp);
 void ModelInstanceDraw3d(ModelInstance* mi);
+void ModelInstanceDraw3dBatch(ModelInstance* mis, i32 count);
 void ModelInstanceDrawImGui(ModelInstance* mi);
 
 struct MeshInstance {
@@ -948,6 +1741,7 @@ struct MeshInstance {
 };
 void* MeshInstanceCreate(MemoryPool* mp);
 void MeshInstanceDraw3d(MeshInstance* mi);
+void MeshInstanceDraw3dBatch(MeshInstance* mis, i32 count);
 void MeshInstanceDrawImGui(MeshInstance* mi);
 
 #define PARTICLE_SYSTEM_MAX_PARTICLES 512
@@ -956,11 +1750,13 @@ struct ParticleSystem {
     Mesh _quad;
     Material* _material;
     v3 velocity;
+    v3 _center; // Mean particle position. Every particle moves by the same step, so it's kept up to date in ParticleSystemUpdate
     i32 count;
 };
 void* ParticleSystemCreate(MemoryPool* mp);
 void ParticleSystemFree(ParticleSystem* psys);
-void ParticleSystemUpdate(ParticleSystem* psys);
+void ParticleSystemUpdate(ParticleSystem* psys, float deltaTime);
+v3 ParticleSystemGetPosition(ParticleSystem* psys);
 void ParticleSystemDraw3d(ParticleSystem* psys);
 
 struct TextureInstance {
@@ -979,6 +1775,8 @@ struct TextureInstance {
 // TODO: Implement texture instance set texture
 void* TextureInstanceCreate(MemoryPool* mp);
 void TextureInstanceDrawUi(TextureInstance* ti);
+void TextureInstanceDrawUiBatch(TextureInstance* tis, i32 count);
+void _TextureInstanceDrawTexture(TextureInstance* ti);
 void TextureInstanceDrawImGui(TextureInstance* ti);
 void TextureInstanceSetTexture(TextureInstance* ti, Texture* texture);
 void TextureInstanceSetSize(TextureInstance* ti, v2 size);
@@ -1003,6 +1801,7 @@ const char* CstringDuplicate(const char* cstr, MemoryPool* mm);
     Init
 */
 #define _MD_GAME_ENGINE_OBJECT_COUNT_MAX 500
+#define _MD_WORKER_MEMORY_SIZE MEGABYTES(8)
 
 enum MD_TYPES {
     MD_TYPE_I32,
@@ -1035,18 +1834,36 @@ i32 MdTypeGetSize(i32 type) {
 
 namespace mdEngine {
     bool initialized = false;
-    MemoryPool scratchMemory;
+    MemoryPool scratchMemory; // Use through ScratchScope. Contents aren't guaranteed to be zeroed
+    MemoryPool frameMemory[2]; // Use through FrameReserve. Contents aren't guaranteed to be zeroed
+    i32 frameMemoryIndex;
+    MemoryPool workerMemory; // Carved into per thread pools with MemoryPoolCreateInsideMemoryPoolConcurrent
+    thread_local MemoryPool threadScratchMemory; // Use through MdEngineGetThreadScratchMemory
+    u64 threadScratchMemorySize;
     MemoryPool sceneMemory;
     MemoryPool persistentMemory;
     MemoryPool engineMemory;
     EventHandler eventHandler;
+    std::thread::id mainThreadId;
+    CoroutineScheduler coroutineScheduler;
     GameObject* currentGameObjectInstance;
+    ArenaArray<GameObjectHandle> gameObjectDespawnQueue;
+    GameObjectStore* currentGameObjectStore; // Store of the object that's being instanced. Used by GameObjectDataReserve
+    JobSystem jobSystem;
+    InstanceStream instanceStream;
+    u32 updateFrame; // Counts calls to GameObjectsUpdate
+    v3 updateOrigin; // Distance based update rates are measured from here. Usually the camera
+    float updateRateDistances[3] = {40.f, 80.f, 160.f}; // Instances further than these update every 2nd, 4th and 8th frame
     Input input;
     Texture missingTexture;
     TextDrawingStyle textDrawingStyleDefault;
-    std::unordered_map<std::string, void*> groups = std::unordered_map<std::string, void*>();
+    u32 sceneGeneration = 1; // Bumped when the scene's objects are freed. Expires service registrations and script state pools
     GameObjectDefinition gameObjectDefinitions[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
     bool gameObjectIsDefined[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    GameObjectStore gameObjectStores[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    i32 gameObjectTypes[_MD_GAME_ENGINE_OBJECT_COUNT_MAX]; // Defined types in registration order
+    i32 gameObjectTypesByDrawOrder[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    i32 gameObjectTypeCount;
     Shader passthroughShader;
 };
 
@@ -1066,6 +1883,16 @@ void MdEngineRegisterObject(GameObjectDefinition def, i32 ind) {
     assert(!mdEngine::gameObjectIsDefined[ind]);
     mdEngine::gameObjectDefinitions[ind] = def;
     mdEngine::gameObjectIsDefined[ind] = true;
+    i32 count = mdEngine::gameObjectTypeCount;
+    mdEngine::gameObjectTypes[count] = ind;
+    // Insertion sort keeps types with equal draw order in registration order
+    i32 i = count;
+    while (i > 0 && mdEngine::gameObjectDefinitions[mdEngine::gameObjectTypesByDrawOrder[i - 1]].drawOrder > def.drawOrder) {
+        mdEngine::gameObjectTypesByDrawOrder[i] = mdEngine::gameObjectTypesByDrawOrder[i - 1];
+        i--;
+    }
+    mdEngine::gameObjectTypesByDrawOrder[i] = ind;
+    mdEngine::gameObjectTypeCount++;
 }
 
 // TODO: Move definition creation to where the object is so that it becomes more easily editable
@@ -1075,35 +1902,50 @@ void MdEngineRegisterObjects() {
     def = GameObjectDefinitionCreate("Dialogue Sequence", DialogueSequenceCreate, mp);
     def.DrawUi = (GameInstanceEventFunction)DialogueSequenceDrawUi;
     def.Update = (GameInstanceEventFunction)DialogueSequenceUpdate;
+    def.Free = (GameInstanceEventFunction)DialogueSequenceFree;
+    def.drawOrder = GAME_OBJECT_DRAW_ORDER_OVERLAY;
+    def.reads = GAME_OBJECT_ACCESS_INPUT;
+    def.writes = GAME_OBJECT_ACCESS_NONE; // Posting events is thread safe. Listeners run later in EventHandlerFlush
+    def.mainThread = false;
     MdEngineRegisterObject(def, OBJECT_DIALOGUE_SEQUENCE);
 
     def = GameObjectDefinitionCreate("Model Instance", ModelInstanceCreate, mp);
     def.Draw3d = (GameInstanceEventFunction)ModelInstanceDraw3d;
+    def.Draw3dBatch = (GameInstanceBatchFunction)ModelInstanceDraw3dBatch;
     def.DrawImGui = (GameInstanceEventFunction)ModelInstanceDrawImGui;
     MdEngineRegisterObject(def, OBJECT_MODEL_INSTANCE);
 
     def = GameObjectDefinitionCreate("Mesh Instance", MeshInstanceCreate, mp);
     def.Draw3d = (GameInstanceEventFunction)MeshInstanceDraw3d;
+    def.Draw3dBatch = (GameInstanceBatchFunction)MeshInstanceDraw3dBatch;
     def.DrawImGui = (GameInstanceEventFunction)MeshInstanceDrawImGui;
     MdEngineRegisterObject(def, OBJECT_MESH_INSTANCE);
 
     def = GameObjectDefinitionCreate("Instance Renderer", InstanceRendererCreate, mp);
     def.Draw3d = (GameInstanceEventFunction)InstanceRendererDraw3d;
+    def.Free = (GameInstanceEventFunction)InstanceRendererFree;
     MdEngineRegisterObject(def, OBJECT_INSTANCE_RENDERER);
 
     def = GameObjectDefinitionCreate("Particle System", ParticleSystemCreate, mp);
     def.Draw3d = (GameInstanceEventFunction)ParticleSystemDraw3d;
-    def.Update = (GameInstanceEventFunction)ParticleSystemUpdate;
+    def.UpdateTimed = (GameInstanceTimedFunction)ParticleSystemUpdate;
+    def.GetPosition = (GameInstancePositionFunction)ParticleSystemGetPosition;
     def.Free = (GameInstanceEventFunction)ParticleSystemFree;
+    def.reads = GAME_OBJECT_ACCESS_NONE;
+    def.writes = GAME_OBJECT_ACCESS_NONE;
+    def.mainThread = false;
+    def.parallelInstances = true;
     MdEngineRegisterObject(def, OBJECT_PARTICLE_SYSTEM);
 
     def = GameObjectDefinitionCreate("Texture Instance", TextureInstanceCreate, mp);
     def.DrawUi = (GameInstanceEventFunction)TextureInstanceDrawUi;
+    def.DrawUiBatch = (GameInstanceBatchFunction)TextureInstanceDrawUiBatch;
     def.DrawImGui = (GameInstanceEventFunction)TextureInstanceDrawImGui;
     MdEngineRegisterObject(def, OBJECT_TEXTURE_INSTANCE);
 
     def = GameObjectDefinitionCreate("Skybox", SkyboxCreate, mp);
     def.Draw3d = (GameInstanceEventFunction)SkyboxDraw3d;
+    def.drawOrder = GAME_OBJECT_DRAW_ORDER_BACKGROUND;
     MdEngineRegisterObject(def, OBJECT_SKYBOX);
 }
 
@@ -1208,17 +2050,37 @@ Shader MdEngineLoadPassthroughShader() {
     return LoadShaderFromMemory(defaultVShaderCode, defaultFShaderCode);
 }
 
-void MdEngineInit(u64 scratchMemorySize, u64 sceneMemorySize, u64 persistentMemorySize, u64 engineMemorySize) {
+void MdEngineInit(u64 scratchMemorySize, u64 sceneMemorySize, u64 persistentMemorySize, u64 engineMemorySize, u64 frameMemorySize) {
     if (mdEngine::initialized) {
         return;
     }
     mdEngine::initialized = true;
-    mdEngine::scratchMemory = MemoryPoolCreate(scratchMemorySize);
-    mdEngine::sceneMemory = MemoryPoolCreate(sceneMemorySize);
+    mdEngine::scratchMemory = MemoryPoolCreateVirtual(scratchMemorySize, 0);
+    mdEngine::frameMemory[0] = MemoryPoolCreateVirtual(frameMemorySize, 0);
+    mdEngine::frameMemory[1] = MemoryPoolCreateVirtual(frameMemorySize, 0);
+    mdEngine::frameMemoryIndex = 0;
+    mdEngine::sceneMemory = MemoryPoolCreateVirtual(sceneMemorySize, MEMORY_POOL_FLAG_DECOMMIT_ON_CLEAR);
     mdEngine::persistentMemory = MemoryPoolCreate(persistentMemorySize);
     mdEngine::engineMemory = MemoryPoolCreate(engineMemorySize);
-    mdEngine::eventHandler = EventHandlerCreate();
+    // NOTE: Not carved out of scene memory, since clearing the scene decommits pages that worker pools still point into
+    mdEngine::workerMemory = MemoryPoolCreate(_MD_WORKER_MEMORY_SIZE);
+    mdEngine::workerMemory.blockSize = 0; // Concurrent reservations can't chain blocks, so the pool has to stay in one buffer
+    mdEngine::threadScratchMemorySize = scratchMemorySize;
+    mdEngine::scratchMemory.name = "Scratch";
+    mdEngine::frameMemory[0].name = "Frame 0";
+    mdEngine::frameMemory[1].name = "Frame 1";
+    mdEngine::sceneMemory.name = "Scene";
+    mdEngine::persistentMemory.name = "Persistent";
+    mdEngine::engineMemory.name = "Engine";
+    mdEngine::workerMemory.name = "Worker";
+    ArenaArrayInit(&mdEngine::gameObjectDespawnQueue, &mdEngine::persistentMemory, 64);
+    // One thread is left for the main thread
+    JobSystemInit((i32)std::thread::hardware_concurrency() - 1);
+    mdEngine::mainThreadId = std::this_thread::get_id();
+    EventHandlerInit(&mdEngine::eventHandler, &mdEngine::persistentMemory);
+    CoroutineSchedulerInit(&mdEngine::coroutineScheduler, &mdEngine::persistentMemory);
     mdEngine::passthroughShader = MdEngineLoadPassthroughShader();
+    InstanceStreamInit(&mdEngine::instanceStream, &mdEngine::persistentMemory);
     {
         TextDrawingStyle tds;
         tds.color = WHITE;
@@ -1233,23 +2095,300 @@ void MdEngineInit(u64 scratchMemorySize, u64 sceneMemorySize, u64 persistentMemo
     InputInit(&mdEngine::input);
 }
 
-// TODO: Consider removing this or GameObjectCreate and just have one function for this
-GameObject MdEngineInstanceGameObject(i32 ind, MemoryPool* mp, const char* instanceName = "") {
-    assert(mdEngine::gameObjectIsDefined[ind]);
-    GameObjectDefinition def = mdEngine::gameObjectDefinitions[ind];
-    GameObject go = GameObjectCreate(def.Create(mp), mp, def.objectName, instanceName);
-    go.Draw3d = def.Draw3d;
-    go.DrawUi = def.DrawUi;
-    go.DrawImGui = def.DrawImGui;
-    go.Free = def.Free;
-    go.Update = def.Update;
-    return go;
+// Memory pools shown in the debug overlay and written by MdEngineDumpMemoryStats
+MemoryPool** MdEngineGetMemoryPools(i32* count) {
+    local_persist MemoryPool* pools[] = {
+        &mdEngine::scratchMemory,
+        &mdEngine::frameMemory[0],
+        &mdEngine::frameMemory[1],
+        &mdEngine::sceneMemory,
+        &mdEngine::workerMemory,
+        &mdEngine::persistentMemory,
+        &mdEngine::engineMemory
+    };
+    *count = sizeof(pools) / sizeof(pools[0]);
+    return pools;
+}
+void MdEngineDrawMemoryImGui() {
+    i32 count = 0;
+    MemoryPool** pools = MdEngineGetMemoryPools(&count);
+    for (i32 i = 0; i < count; i++) {
+        MemoryPoolDrawImGui(pools[i]);
+    }
+}
+bool MdEngineDumpMemoryStats(const char* fileName) {
+    i32 count = 0;
+    MemoryPool** pools = MdEngineGetMemoryPools(&count);
+    StringBuilder sb = StringBuilderCreate(KILOBYTES(16), MdEngineGetFrameMemory());
+    sb.separator = '\n';
+    for (i32 i = 0; i < count; i++) {
+        StringBuilderAddString(&sb, MemoryPoolGetStatsText(pools[i]));
+    }
+    StringBuilderAddChar(&sb, '\0');
+    return SaveFileText(fileName, sb.str);
 }
 
-/*
-    Engine dependent utility implementations
-*/
-const char* CstringDuplicate(const char* cstr, MemoryPool* mm) {
+// Scratch memory owned by the calling thread. Reserved on first use, so threads that never ask for it don't pay for it.
+// The main thread keeps using mdEngine::scratchMemory
+MemoryPool* MdEngineGetThreadScratchMemory() {
+    if (mdEngine::threadScratchMemory.buffer == nullptr) {
+        mdEngine::threadScratchMemory = MemoryPoolCreateVirtual(mdEngine::threadScratchMemorySize, 0);
+        mdEngine::threadScratchMemory.name = "Thread scratch";
+    }
+    return &mdEngine::threadScratchMemory;
+}
+// Worker threads have to call this before they exit
+void MdEngineReleaseThreadScratchMemory() {
+    if (mdEngine::threadScratchMemory.buffer != nullptr) {
+        MemoryPoolDestroy(&mdEngine::threadScratchMemory);
+    }
+}
+
+// Zero workers is valid, every pushed job then runs on the main thread inside JobSystemWaitAll
+void JobSystemInit(i32 workerCount) {
+    JobSystem* js = &mdEngine::jobSystem;
+    js->workerCount = iclampi(workerCount, 0, _MD_JOB_SYSTEM_WORKER_COUNT_MAX);
+    js->_pushIndex = 0;
+    js->_queued = 0;
+    js->_pending = 0;
+    js->_running = true;
+    for (i32 i = 0; i < js->workerCount; i++) {
+        js->workers[i] = std::thread(_JobSystemWorkerMain, i);
+    }
+}
+void JobSystemShutdown() {
+    JobSystem* js = &mdEngine::jobSystem;
+    JobSystemWaitAll();
+    {
+        std::lock_guard<std::mutex> lock(js->_sleepMutex);
+        js->_running = false;
+    }
+    js->_wake.notify_all();
+    for (i32 i = 0; i < js->workerCount; i++) {
+        js->workers[i].join();
+    }
+    js->workerCount = 0;
+}
+// Only call from the main thread. Jobs are handed to the workers round robin
+void JobSystemPush(JobFunction run, void* data) {
+    JobSystem* js = &mdEngine::jobSystem;
+    if (js->workerCount == 0) {
+        run(data);
+        return;
+    }
+    JobQueue* queue = &js->queues[js->_pushIndex];
+    js->_pushIndex = (js->_pushIndex + 1) % js->workerCount;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->count == _MD_JOB_QUEUE_CAPACITY) {
+            // NOTE: Running the job right away is always correct since nothing waits on a single job
+            queue = nullptr;
+        } else {
+            queue->jobs[(queue->head + queue->count) % _MD_JOB_QUEUE_CAPACITY] = {run, data};
+            queue->count++;
+            js->_pending++;
+            js->_queued++;
+        }
+    }
+    if (queue == nullptr) {
+        run(data);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(js->_sleepMutex);
+    }
+    js->_wake.notify_one();
+}
+// Runs queued jobs on the calling thread until every pushed job has finished
+void JobSystemWaitAll() {
+    JobSystem* js = &mdEngine::jobSystem;
+    while (js->_pending > 0) {
+        if (!_JobSystemTryRunJob(0)) {
+            std::this_thread::yield();
+        }
+    }
+}
+// The owner takes the newest job while thieves take the oldest one, so they rarely fight over the same end of the queue
+bool _JobQueuePop(JobQueue* queue, Job* job, bool steal) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->count == 0) {
+        return false;
+    }
+    if (steal) {
+        *job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % _MD_JOB_QUEUE_CAPACITY;
+    } else {
+        *job = queue->jobs[(queue->head + queue->count - 1) % _MD_JOB_QUEUE_CAPACITY];
+    }
+    queue->count--;
+    return true;
+}
+bool _JobSystemTryRunJob(i32 queueIndex) {
+    JobSystem* js = &mdEngine::jobSystem;
+    Job job = {};
+    bool found = _JobQueuePop(&js->queues[queueIndex], &job, false);
+    for (i32 i = 1; i < js->workerCount && !found; i++) {
+        found = _JobQueuePop(&js->queues[(queueIndex + i) % js->workerCount], &job, true);
+    }
+    if (!found) {
+        return false;
+    }
+    js->_queued--;
+    job.Run(job.data);
+    js->_pending--;
+    return true;
+}
+void _JobSystemWorkerMain(i32 workerIndex) {
+    JobSystem* js = &mdEngine::jobSystem;
+    while (true) {
+        if (_JobSystemTryRunJob(workerIndex)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(js->_sleepMutex);
+        js->_wake.wait(lock, [js]{return js->_queued > 0 || !js->_running;});
+        if (!js->_running) {
+            break;
+        }
+    }
+    MdEngineReleaseThreadScratchMemory();
+}
+
+// Frame memory is double buffered so that memory reserved during the previous frame stays valid for one more frame
+void MdEngineBeginFrame() {
+    mdEngine::frameMemoryIndex = (mdEngine::frameMemoryIndex + 1) % 2;
+    MemoryPoolRestore(&mdEngine::frameMemory[mdEngine::frameMemoryIndex], {nullptr, 0}, false);
+}
+MemoryPool* MdEngineGetFrameMemory() {
+    return &mdEngine::frameMemory[mdEngine::frameMemoryIndex];
+}
+template <typename T>
+T* FrameReserve(u64 count) {
+    return MemoryReserve<T>(MdEngineGetFrameMemory(), count);
+}
+
+// Stores grow up to their definition's capacity. Check this where running out of room isn't a bug
+bool MdEngineCanInstanceGameObject(i32 ind) {
+    assert(mdEngine::gameObjectIsDefined[ind]);
+    GameObjectStore* store = &mdEngine::gameObjectStores[ind];
+    i32 capacity = store->objects == nullptr ? mdEngine::gameObjectDefinitions[ind].capacity : store->capacity;
+    return store->_freeCount > 0 || store->count < capacity;
+}
+// TODO: Consider removing this or GameObjectCreate and just have one function for this
+// Returned pointer stays valid until the object is despawned. Keep a GameObjectHandle for anything longer lived
+GameObject* MdEngineInstanceGameObject(i32 ind, MemoryPool* mp, const char* instanceName = "") {
+    assert(mdEngine::gameObjectIsDefined[ind]);
+    GameObjectDefinition def = mdEngine::gameObjectDefinitions[ind];
+    GameObjectStore* store = &mdEngine::gameObjectStores[ind];
+    MemoryTagScope tag(mp, MEMORY_TAG_GAME_OBJECTS);
+    if (store->objects == nullptr) {
+        store->capacity = def.capacity;
+        store->objects = (GameObject*)_GameObjectStoreArrayInit(&store->_objectsMemory, store->capacity, sizeof(GameObject));
+        store->info = (GameObjectInfo*)_GameObjectStoreArrayInit(&store->_infoMemory, store->capacity, sizeof(GameObjectInfo));
+        store->_freeIndices = (i32*)_GameObjectStoreArrayInit(&store->_freeIndicesMemory, store->capacity, sizeof(i32));
+    }
+    i32 index = -1;
+    if (store->_freeCount > 0) {
+        store->_freeCount--;
+        index = store->_freeIndices[store->_freeCount];
+        // Create functions expect zeroed memory
+        memset(store->data + index * store->stride, 0, store->stride);
+    } else {
+        if (store->count == store->capacity) {
+            // NOTE: Doesn't return, so callers can use the result right away
+            TraceLog(LOG_FATAL, TextFormat("%s: Ran out of room for objects of type '%s', raise its capacity", nameof(MdEngineInstanceGameObject), def.objectName));
+        }
+        index = store->count;
+        store->count++;
+        MemoryReserve<GameObject>(&store->_objectsMemory);
+        MemoryReserve<GameObjectInfo>(&store->_infoMemory);
+        MemoryReserve<i32>(&store->_freeIndicesMemory);
+    }
+    store->_instancingIndex = index;
+    mdEngine::currentGameObjectStore = store;
+    void* data = def.Create(mp);
+    mdEngine::currentGameObjectStore = nullptr;
+    assert(data == store->data + index * store->stride); // Create function has to reserve its data with GameObjectDataReserve
+    GameObject* go = store->objects + index;
+    GameObjectInfo* info = store->info + index;
+    u32 generation = info->generation > 0 ? info->generation : 1;
+    *go = GameObjectCreate(data);
+    go->type = (i16)ind;
+    go->alive = true;
+    go->_lastUpdateFrame = (u8)mdEngine::updateFrame;
+    if (store->_names.memoryPool == nullptr) {
+        store->_names = ObjectPoolCreate<GameObjectName>(mp);
+    }
+    *info = GameObjectInfoCreate(&store->_names, def.objectName, instanceName);
+    info->generation = generation;
+    return go;
+}
+template <typename T>
+ServiceEntry* _ServiceGetEntry() {
+    local_persist ServiceEntry entry = {};
+    return &entry;
+}
+// For services that aren't game objects. The pointer has to stay valid for the rest of the scene
+template <typename T>
+void ServiceRegister(T* service) {
+    ServiceEntry* entry = _ServiceGetEntry<T>();
+    entry->pointer = (void*)service;
+    entry->handle = {};
+    entry->sceneGeneration = mdEngine::sceneGeneration;
+}
+// Resolved through a handle, so the service disappears when the object is despawned
+template <typename T>
+void ServiceRegisterObject(GameObject* obj) {
+    ServiceEntry* entry = _ServiceGetEntry<T>();
+    entry->pointer = nullptr;
+    entry->handle = GameObjectGetHandle(obj);
+    entry->sceneGeneration = mdEngine::sceneGeneration;
+}
+// Returns nullptr when nothing is registered in the current scene
+template <typename T>
+T* ServiceGet() {
+    ServiceEntry* entry = _ServiceGetEntry<T>();
+    if (entry->sceneGeneration != mdEngine::sceneGeneration) {
+        return nullptr;
+    }
+    if (entry->handle.generation != 0) {
+        return (T*)GameObjectResolveData(entry->handle);
+    }
+    return (T*)entry->pointer;
+}
+// Reserves the data of the object that's being instanced. Create functions use this instead of MemoryReserve
+// so that the data lands in the type's store. Outside of instancing it falls back to a plain reservation
+template <typename T>
+T* GameObjectDataReserve(MemoryPool* mp) {
+    GameObjectStore* store = mdEngine::currentGameObjectStore;
+    if (store == nullptr) {
+        return MemoryReserve<T>(mp);
+    }
+    if (store->data == nullptr) {
+        store->data = (byte*)_GameObjectStoreArrayInit(&store->_dataMemory, store->capacity, sizeof(T));
+        store->stride = sizeof(T);
+    }
+    assert(store->stride == sizeof(T)); // Create function reserved a different type than last time
+    T* data = (T*)(store->data + store->_instancingIndex * store->stride);
+    // NOTE: Recycled slots are committed already
+    if (store->_dataMemory.location == (u64)store->_instancingIndex * store->stride) {
+        MemoryReserve<T>(&store->_dataMemory);
+    }
+    return data;
+}
+// Reserves address space for 'capacity' elements. The array never moves, and elements get committed one reservation at a time
+void* _GameObjectStoreArrayInit(MemoryPool* mp, i32 capacity, u64 elementSize) {
+    *mp = MemoryPoolCreateVirtual((u64)capacity * elementSize, 0);
+    // NOTE: Tightly packed so that consecutive reservations are consecutive elements
+    mp->alignment = 0;
+    mp->blockSize = 0; // A chained block would break up the array
+    mp->name = "Game object store";
+    return mp->buffer;
+}
+
+/*
+    Engine dependent utility implementations
+*/
+const char* CstringDuplicate(const char* cstr, MemoryPool* mm) {
     i32 len = (i32)strlen(cstr);
     char* cstrNew = MemoryReserve<char>(mm, len + 1);
     strcpy_s(cstrNew, len + 1, cstr);
@@ -1266,53 +2405,326 @@ MemoryPool MemoryPoolCreate(u64 size) {
     mp.location = 0;
     mp.size = size;
     mp.alignment = sizeof(void*);
+    mp.blockSize = size;
+    mp.flags = 0;
+    mp._committed = size;
+    mp._block = nullptr;
     return mp;
 }
+// Reserves 'size' bytes of address space up front and commits pages as the pool fills up
+MemoryPool MemoryPoolCreateVirtual(u64 size, u32 flags) {
+    bool hugePages = (flags & MEMORY_POOL_FLAG_HUGE_PAGES) != 0;
+    MemoryPool mp = {};
+    mp.size = VirtualMemoryRoundUp(size, hugePages ? VIRTUAL_MEMORY_HUGE_PAGE_SIZE : VIRTUAL_MEMORY_GRANULARITY);
+    mp.buffer = VirtualMemoryReserve(mp.size, hugePages);
+    if (mp.buffer == nullptr) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Couldn't reserve address space, falling back to calloc", nameof(MemoryPoolCreateVirtual)));
+        return MemoryPoolCreate(size);
+    }
+    mp.location = 0;
+    mp.alignment = sizeof(void*);
+    mp.blockSize = mp.size;
+    mp.flags = flags | MEMORY_POOL_FLAG_VIRTUAL;
+    mp._committed = 0;
+    mp._block = nullptr;
+    return mp;
+}
+// NOTE: Nested memory pools can't grow, so their contents can be addressed by offset from the buffer
 MemoryPool MemoryPoolCreateInsideMemoryPool(MemoryPool* srcMp, u64 size) {
     MemoryPool mp = {};
     mp.buffer = MemoryPoolReserve(srcMp, size);
     mp.location = 0;
     mp.size = size;
+    mp.blockSize = 0;
+    mp.flags = 0;
+    mp._committed = size;
+    mp._block = nullptr;
     return mp;
 }
-void MemoryPoolExpand(MemoryPool* mp) {
-    // TODO: Implement
-    /*
-        Cases in which its allowed to expand memory
-        1. request to expand comes from front of memory pool
-        2. request to expand comes from foremost nested memory pool
-        This would help all the memory usages to be checked at the beginning of the game
-    */
-    assert(false);
+// Carves a fixed size pool out of 'srcMp' without locking. Safe to call from several threads at once
+MemoryPool MemoryPoolCreateInsideMemoryPoolConcurrent(MemoryPool* srcMp, u64 size) {
+    MemoryPool mp = {};
+    mp.buffer = MemoryPoolReserveConcurrent(srcMp, size, CACHE_LINE_SIZE);
+    mp.location = 0;
+    mp.size = mp.buffer != nullptr ? size : 0;
+    mp.alignment = sizeof(void*);
+    mp.blockSize = 0;
+    mp.flags = 0;
+    mp._committed = mp.size;
+    mp._block = nullptr;
+    return mp;
+}
+// Chains a new block onto the pool that fits at least 'size' bytes. Earlier blocks stay where they are
+void MemoryPoolExpand(MemoryPool* mp, u64 size) {
+    assert(mp->blockSize > 0); // Pool isn't allowed to grow
+    u64 blockSize = mp->blockSize > size ? mp->blockSize : size;
+    MemoryPoolBlock* block = (MemoryPoolBlock*)calloc(1, sizeof(MemoryPoolBlock) + blockSize);
+    assert(block != nullptr);
+    block->previous = mp->_block;
+    block->buffer = mp->buffer;
+    block->location = mp->location;
+    block->size = mp->size;
+    block->committed = mp->_committed;
+    mp->_chainedUsed += mp->location;
+    mp->_block = block;
+    mp->buffer = (void*)(block + 1);
+    mp->location = 0;
+    mp->size = blockSize;
+    mp->_committed = blockSize;
+}
+// Makes sure the virtual buffer is committed up to 'location'
+void MemoryPoolCommit(MemoryPool* mp, u64 location) {
+    assert(mp->_block == nullptr && (mp->flags & MEMORY_POOL_FLAG_VIRTUAL));
+    u64 granularity = (mp->flags & MEMORY_POOL_FLAG_HUGE_PAGES) ? VIRTUAL_MEMORY_HUGE_PAGE_SIZE : VIRTUAL_MEMORY_GRANULARITY;
+    u64 committed = uimini(VirtualMemoryRoundUp(location, granularity), mp->size);
+    if (committed <= mp->_committed) {
+        return;
+    }
+    bool success = VirtualMemoryCommit((byte*)mp->buffer + mp->_committed, committed - mp->_committed);
+    assert(success); // Out of physical memory
+    mp->_committed = committed;
+}
+void _MemoryPoolPopBlock(MemoryPool* mp) {
+    MemoryPoolBlock* block = mp->_block;
+    mp->buffer = block->buffer;
+    mp->location = block->location;
+    mp->size = block->size;
+    mp->_committed = block->committed;
+    mp->_chainedUsed -= block->location;
+    mp->_block = block->previous;
+    free(block);
 }
 void MemoryPoolDestroy(MemoryPool* mp) {
+    while (mp->_block != nullptr) {
+        _MemoryPoolPopBlock(mp);
+    }
     if (mp->buffer != nullptr) {
-        free(mp->buffer);
+        if (mp->flags & MEMORY_POOL_FLAG_VIRTUAL) {
+            VirtualMemoryRelease(mp->buffer, mp->size);
+        } else {
+            free(mp->buffer);
+        }
     }
+    mp->buffer = nullptr;
 }
-void* MemoryPoolReserve(MemoryPool* mp, u64 size) {
-    assert(mp->location + size < mp->size); // Out of memory check
+inline u64 _MemoryPoolGetPadding(MemoryPool* mp, u64 alignment) {
+    u64 address = (u64)(uintptr_t)((byte*)mp->buffer + mp->location);
+    return (alignment - (address & (alignment - 1))) & (alignment - 1);
+}
+// Alignment has to be a power of two. The pool's own alignment is used when it's larger
+void* MemoryPoolReserve(MemoryPool* mp, u64 size, u64 alignment) {
     assert(size > 0);
-    void* reserve = (byte*)mp->buffer + mp->location;
-    mp->location += size;
-    if (mp->alignment != 0 && mp->location % mp->alignment != 0) {
-        u64 alignedLocation = mp->location + (sizeof(void*) - (mp->location % sizeof(void*)));
-        mp->location = uimini(alignedLocation, mp->size);
+    alignment = alignment > mp->alignment ? alignment : mp->alignment;
+    alignment = alignment > 0 ? alignment : 1;
+    assert((alignment & (alignment - 1)) == 0);
+    u64 padding = _MemoryPoolGetPadding(mp, alignment);
+    if (mp->location + padding + size > mp->_committed) {
+        if (mp->_block == nullptr && (mp->flags & MEMORY_POOL_FLAG_VIRTUAL) && mp->location + padding + size <= mp->size) {
+            MemoryPoolCommit(mp, mp->location + padding + size);
+        } else {
+            MemoryPoolExpand(mp, size + alignment - 1);
+            padding = _MemoryPoolGetPadding(mp, alignment);
+        }
     }
+    void* reserve = (byte*)mp->buffer + mp->location + padding;
+    mp->location += padding + size;
+    u64 used = mp->_chainedUsed + mp->location;
+    mp->highWaterMark = used > mp->highWaterMark ? used : mp->highWaterMark;
+    mp->allocationCount++;
+    mp->tagBytes[mp->tag] += size;
     return reserve;
 }
+// Grows the reservation at 'ptr' from 'size' to 'sizeNew' bytes without moving it.
+// Only possible while it's the last reservation in the pool's current buffer and the buffer has room left
+bool MemoryPoolExtend(MemoryPool* mp, void* ptr, u64 size, u64 sizeNew) {
+    assert(sizeNew >= size);
+    if ((byte*)ptr + size != (byte*)mp->buffer + mp->location) {
+        return false;
+    }
+    u64 locationNew = mp->location + (sizeNew - size);
+    if (locationNew > mp->_committed) {
+        if (mp->_block == nullptr && (mp->flags & MEMORY_POOL_FLAG_VIRTUAL) && locationNew <= mp->size) {
+            MemoryPoolCommit(mp, locationNew);
+        } else {
+            return false;
+        }
+    }
+    mp->location = locationNew;
+    u64 used = mp->_chainedUsed + mp->location;
+    mp->highWaterMark = used > mp->highWaterMark ? used : mp->highWaterMark;
+    mp->tagBytes[mp->tag] += sizeNew - size;
+    return true;
+}
+// Lock-free bump allocation for pools that are shared between threads.
+// Only moves through memory that's already committed and never grows the pool, so it returns nullptr when the pool is full.
+// Statistics other than the location aren't updated.
+// NOTE: Don't mix with MemoryPoolReserve on the same pool while other threads are reserving from it
+void* MemoryPoolReserveConcurrent(MemoryPool* mp, u64 size, u64 alignment) {
+    assert(size > 0);
+    alignment = alignment > mp->alignment ? alignment : mp->alignment;
+    alignment = alignment > 0 ? alignment : 1;
+    assert((alignment & (alignment - 1)) == 0);
+    volatile u64* locationPtr = (volatile u64*)&mp->location;
+    u64 location = *locationPtr;
+    for (;;) {
+        u64 address = (u64)(uintptr_t)((byte*)mp->buffer + location);
+        u64 padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        u64 locationNew = location + padding + size;
+        if (locationNew > mp->_committed) {
+            return nullptr;
+        }
+        u64 locationPrevious = AtomicCompareExchangeU64(locationPtr, location, locationNew);
+        if (locationPrevious == location) {
+            return (byte*)mp->buffer + location + padding;
+        }
+        location = locationPrevious;
+    }
+}
+// Frees every chained block and zeroes the used part of the first buffer
 void MemoryPoolClear(MemoryPool* mp) {
     assert(mp->size > 0);
-    memset(mp->buffer, 0, mp->location);
+    while (mp->_block != nullptr) {
+        _MemoryPoolPopBlock(mp);
+    }
+    if ((mp->flags & MEMORY_POOL_FLAG_VIRTUAL) && (mp->flags & MEMORY_POOL_FLAG_DECOMMIT_ON_CLEAR) && mp->_committed > VIRTUAL_MEMORY_GRANULARITY) {
+        // Pages handed back to the OS come back zeroed, so only the part that stays committed needs a memset
+        memset(mp->buffer, 0, uimini(mp->location, VIRTUAL_MEMORY_GRANULARITY));
+        VirtualMemoryDecommit((byte*)mp->buffer + VIRTUAL_MEMORY_GRANULARITY, mp->_committed - VIRTUAL_MEMORY_GRANULARITY);
+        mp->_committed = VIRTUAL_MEMORY_GRANULARITY;
+    } else {
+        memset(mp->buffer, 0, mp->location);
+    }
     mp->location = 0;
+    memset(mp->tagBytes, 0, sizeof(mp->tagBytes));
+}
+u64 MemoryPoolGetUsed(MemoryPool* mp) {
+    return mp->_chainedUsed + mp->location;
+}
+u64 MemoryPoolGetCapacity(MemoryPool* mp) {
+    u64 capacity = mp->size;
+    for (MemoryPoolBlock* block = mp->_block; block != nullptr; block = block->previous) {
+        capacity += block->size;
+    }
+    return capacity;
+}
+void MemoryPoolDrawImGui(MemoryPool* mp) {
+    u64 used = MemoryPoolGetUsed(mp);
+    u64 capacity = MemoryPoolGetCapacity(mp);
+    float fraction = capacity > 0 ? (float)((double)used / (double)capacity) : 0.f;
+    ImGui::ProgressBar(fraction, ImVec2(-FLT_MIN, 0.f), TextFormat("%s: %llu / %llu", mp->name, used, capacity));
+    if (ImGui::TreeNode(mp, "%s details", mp->name)) {
+        ImGui::Text("High water mark: %llu", mp->highWaterMark);
+        ImGui::Text("Allocations: %llu", mp->allocationCount);
+        ImGui::Text("Committed: %llu", mp->_committed);
+        for (i32 i = 0; i < MEMORY_TAG_COUNT; i++) {
+            float tagFraction = used > 0 ? (float)((double)mp->tagBytes[i] / (double)used) : 0.f;
+            ImGui::ProgressBar(tagFraction, ImVec2(-FLT_MIN, 0.f), TextFormat("%s: %llu", memoryTagNames[i], mp->tagBytes[i]));
+        }
+        ImGui::TreePop();
+    }
+}
+// NOTE: Returned text lives in TextFormat's buffer, so it has to be copied before the next TextFormat call
+const char* MemoryPoolGetStatsText(MemoryPool* mp) {
+    return TextFormat(
+        "%s\n  used: %llu\n  capacity: %llu\n  high water mark: %llu\n  allocations: %llu\n"
+        "  %s: %llu\n  %s: %llu\n  %s: %llu\n  %s: %llu\n  %s: %llu\n  %s: %llu\n",
+        mp->name,
+        MemoryPoolGetUsed(mp),
+        MemoryPoolGetCapacity(mp),
+        mp->highWaterMark,
+        mp->allocationCount,
+        memoryTagNames[MEMORY_TAG_UNTAGGED], mp->tagBytes[MEMORY_TAG_UNTAGGED],
+        memoryTagNames[MEMORY_TAG_GAME_OBJECTS], mp->tagBytes[MEMORY_TAG_GAME_OBJECTS],
+        memoryTagNames[MEMORY_TAG_FOREST], mp->tagBytes[MEMORY_TAG_FOREST],
+        memoryTagNames[MEMORY_TAG_HEIGHTMAP], mp->tagBytes[MEMORY_TAG_HEIGHTMAP],
+        memoryTagNames[MEMORY_TAG_DIALOGUE], mp->tagBytes[MEMORY_TAG_DIALOGUE],
+        memoryTagNames[MEMORY_TAG_COROUTINES], mp->tagBytes[MEMORY_TAG_COROUTINES]);
+}
+MemoryTagScope::MemoryTagScope(MemoryPool* mp, i32 tag) {
+    assert(tag >= 0 && tag < MEMORY_TAG_COUNT);
+    this->memoryPool = mp;
+    this->tagPrevious = mp->tag;
+    mp->tag = tag;
+}
+MemoryTagScope::~MemoryTagScope() {
+    this->memoryPool->tag = this->tagPrevious;
+}
+MemoryPoolMarker MemoryPoolGetMarker(MemoryPool* mp) {
+    MemoryPoolMarker marker = {mp->_block, mp->location};
+    memcpy(marker.tagBytes, mp->tagBytes, sizeof(mp->tagBytes));
+    return marker;
+}
+// Pops blocks chained on after the marker was taken and moves the bump pointer back to it
+void MemoryPoolRestore(MemoryPool* mp, MemoryPoolMarker marker, bool zero) {
+    while (mp->_block != marker.block) {
+        assert(mp->_block != nullptr); // Marker doesn't belong to this pool or was already released
+        _MemoryPoolPopBlock(mp);
+    }
+    assert(marker.location <= mp->location);
+    if (zero) {
+        memset((byte*)mp->buffer + marker.location, 0, mp->location - marker.location);
+    }
+    mp->location = marker.location;
+    memcpy(mp->tagBytes, marker.tagBytes, sizeof(mp->tagBytes));
+}
+ScratchScope::ScratchScope(MemoryPool* mp, bool zero) {
+    this->memoryPool = mp;
+    this->marker = MemoryPoolGetMarker(mp);
+    this->zero = zero;
+}
+ScratchScope::~ScratchScope() {
+    MemoryPoolRestore(this->memoryPool, this->marker, this->zero);
 }
 template <typename T>
 T* MemoryReserve(MemoryPool* mp) {
-    return (T*)MemoryPoolReserve(mp, sizeof(T));
+    return (T*)MemoryPoolReserve(mp, sizeof(T), alignof(T));
 }
 template <typename T>
 T* MemoryReserve(MemoryPool* mp, u64 size) {
-    return (T*)MemoryPoolReserve(mp, sizeof(T) * size);
+    return (T*)MemoryPoolReserve(mp, sizeof(T) * size, alignof(T));
+}
+template <typename T>
+T* MemoryReserveAligned(MemoryPool* mp, u64 size, u64 alignment) {
+    return (T*)MemoryPoolReserve(mp, sizeof(T) * size, alignment > alignof(T) ? alignment : alignof(T));
+}
+
+template <typename T>
+ObjectPool<T> ObjectPoolCreate(MemoryPool* mp, i32 slabCapacity) {
+    assert(slabCapacity > 0);
+    ObjectPool<T> pool = {};
+    pool.memoryPool = mp;
+    pool._freeList = nullptr;
+    pool._slab = nullptr;
+    pool._slabUsed = 0;
+    pool.slabCapacity = slabCapacity;
+    pool.count = 0;
+    return pool;
+}
+// Returns zeroed memory
+template <typename T>
+T* ObjectPoolAlloc(ObjectPool<T>* pool) {
+    ObjectPoolSlot<T>* slot = pool->_freeList;
+    if (slot != nullptr) {
+        pool->_freeList = slot->next;
+        memset(slot, 0, sizeof(ObjectPoolSlot<T>));
+    } else {
+        if (pool->_slab == nullptr || pool->_slabUsed == pool->slabCapacity) {
+            pool->_slab = MemoryReserve<ObjectPoolSlot<T>>(pool->memoryPool, pool->slabCapacity);
+            pool->_slabUsed = 0;
+        }
+        slot = pool->_slab + pool->_slabUsed;
+        pool->_slabUsed++;
+    }
+    pool->count++;
+    return (T*)slot->data;
+}
+template <typename T>
+void ObjectPoolFree(ObjectPool<T>* pool, T* obj) {
+    assert(obj != nullptr && pool->count > 0);
+    ObjectPoolSlot<T>* slot = (ObjectPoolSlot<T>*)obj;
+    slot->next = pool->_freeList;
+    pool->_freeList = slot;
+    pool->count--;
 }
 
 void InputInit(Input* input) {
@@ -1409,43 +2821,38 @@ void _StringBuilderAddChar(StringBuilder* sb, char chr) {
     sb->position++;
 }
 
-// TODO: Stop calling malloc
-String StringCreate(char* text) {
-    String str = {};
-    str.cstr = nullptr;
-    str.length = 0;
-    return StringSet(str, text);
+String StringCreate(const char* text, MemoryPool* mp) {
+    i32 length = (i32)strlen(text);
+    String str = _StringCreate(length, mp);
+    memcpy(str.cstr, text, length);
+    return str;
 }
-String _StringCreate(i32 length) {
+String _StringCreate(i32 length, MemoryPool* mp) {
+    assert(mp != nullptr);
     String str = {};
-    str.cstr = (char*)malloc(length + 1);
-    memset(str.cstr, 0, length);
+    str.cstr = MemoryReserve<char>(mp, length + 1);
     str.cstr[length] = '\0';
     str.length = length;
     return str;
 }
-String StringSet(String str, char* text) {
-    i32 len = (i32)strlen(text) + 1;
-    if (str.cstr != nullptr) {
-        free(str.cstr);
-    }
-    str.cstr = (char*)malloc(len);
-    _memccpy(str.cstr, text, '\0', len);
-    str.length = len;
-    return str;
+StringView StringViewCreate(String str) {
+    return {str.cstr, str.length};
 }
-String StringSubstr(String str, i32 start, i32 count) {
-    if (count >= (str.length + 1) - start) {
-        count = str.length - start;
-    }
-    String substr = _StringCreate(count);
-    _memccpy(substr.cstr, &str.cstr[start], '\0', count);
-    return substr;
+StringView StringSubstr(String str, i32 start, i32 count) {
+    return StringViewSubstr(StringViewCreate(str), start, count);
 }
-void StringDestroy(String str) {
-    if (str.cstr != nullptr) {
-        free(str.cstr);
-    }
+// Start and count get clamped to the view
+StringView StringViewSubstr(StringView view, i32 start, i32 count) {
+    start = iclampi(start, 0, view.length);
+    count = iclampi(count, 0, view.length - start);
+    return {view.data + start, count};
+}
+// Copies the view into a null terminated string. Pass frame memory for strings that are only needed while drawing
+char* StringViewToCstr(StringView view, MemoryPool* mp) {
+    char* cstr = MemoryReserve<char>(mp, view.length + 1);
+    memcpy(cstr, view.data, view.length);
+    cstr[view.length] = '\0';
+    return cstr;
 }
 
 u8 MarchingSquaresGetData(MarchingSquaresResult* msr, i32 x, i32 y) {
@@ -1787,210 +3194,413 @@ void _TweenEnd(Tween* t) {
     memcpy(t->data, t->end, MdTypeGetSize(t->dataType));
 }
 
-VariableDynamicBuffer VariableDynamicBufferCreate(MemoryPool* mp) {
-    VariableDynamicBuffer vdb = {};
-    vdb.memoryPool = MemoryPoolCreateInsideMemoryPool(mp, VariableDynamicBuffer::BUFFER_SIZE);
-    vdb.memoryPool.alignment = 0;
-    vdb.locations = TypeListCreate(MD_TYPE_I32, mp, 5);
-    vdb.types = TypeListCreate(MD_TYPE_I32, mp, 5);
-    vdb.variableCount = 0;
-    return vdb;
-}
-i32 VariableDynamicBufferPush(VariableDynamicBuffer* vdb, void* value, i32 type) {
-    i32 typeSize = MdTypeGetSize(type);
-    u64 location = vdb->memoryPool.location;
-    void* valueDest = MemoryPoolReserve(&vdb->memoryPool, typeSize);
-    TypeListPushBackI32(vdb->types, type);
-    TypeListPushBackI32(vdb->locations, location);
-    memcpy(valueDest, value, typeSize);
-    i32 index = vdb->variableCount;
-    vdb->variableCount++;
-    return index;
-}
-void* VariableDynamicBufferGet(VariableDynamicBuffer* vdb, i32 index, i32 type) {
-    i32 variableType = TypeListGetI32(vdb->types, index);
-    if (variableType != type) {
-        assert(false);
-        TraceLog(LOG_ERROR, TextFormat("%s: Variable types of index didn't match", nameof(VariableDynamicBufferGet)));
-        return nullptr;
-    }
-    i32 variableLocation = TypeListGetI32(vdb->locations, index);
-    return (byte*)vdb->memoryPool.buffer + variableLocation;
-}
-void VariableDynamicBufferSet(VariableDynamicBuffer* vdb, i32 index, i32 type, void* value) {
-    i32 variableType = TypeListGetI32(vdb->types, index);
-    if (variableType != type) {
-        assert(false);
-        TraceLog(LOG_ERROR, TextFormat("%s: Variable types of index didn't match", nameof(VariableDynamicBufferGet)));
-        return;
-    }
-    i32 variableLocation = TypeListGetI32(vdb->locations, index);
-    void* variablePtr = (byte*)vdb->memoryPool.buffer + variableLocation;
-    memcpy(variablePtr, value, MdTypeGetSize(type));
-}
-
 // TODO: Rename because the memory pool parameter causes confusion
 GameObjectDefinition GameObjectDefinitionCreate(const char* objectName, GameInstanceCreateFunction createFunc, MemoryPool* mp) {
     GameObjectDefinition def = {};
     def.Create = createFunc;
     def.objectName = CstringDuplicate(objectName, mp);
+    def.capacity = _MD_GAME_OBJECT_STORE_CAPACITY_DEFAULT;
+    def.drawOrder = GAME_OBJECT_DRAW_ORDER_DEFAULT;
+    // NOTE: Types have to opt in to running off the main thread by declaring what they touch
+    def.reads = GAME_OBJECT_ACCESS_ALL;
+    def.writes = GAME_OBJECT_ACCESS_ALL;
+    def.mainThread = true;
     return def;
 }
-GameObject GameObjectCreate(void* data, MemoryPool* mp, const char* objectName, const char* instanceName) {
+GameObject GameObjectCreate(void* data) {
     GameObject go = {};
-    go.variableBuffer = VariableDynamicBufferCreate(mp);
-    go.variableIndices = std::unordered_map<std::string, i32>();
     go.data = data;
     go.active = true;
     go.visible = true;
-    go.objectName = CstringDuplicate(objectName, mp);
-    go.instanceName = CstringDuplicate(instanceName, mp);
-    go.id = GameObject::idCounter;
-    GameObject::idCounter++;
     return go;
 }
-// TODO: Change variable dynamic buffer initialization to happen here
-void GameObjectAddScript(GameObject* obj, GameObjectScriptFunc initScript, GameObjectScriptFunc updateScript) {
-    mdEngine::currentGameObjectInstance = obj;
-    initScript(obj, obj->data);
-    mdEngine::currentGameObjectInstance = NULL;
-    // TODO: Freeze memory pool. We don't want to be able to create more variables during the scene
+// NOTE: 'objectName' isn't copied. It's expected to be the definition's name, which lives as long as the engine
+GameObjectInfo GameObjectInfoCreate(ObjectPool<GameObjectName>* names, const char* objectName, const char* instanceName) {
+    GameObjectInfo info = {};
+    info.objectName = objectName;
+    GameObjectName* name = ObjectPoolAlloc(names);
+    // NOTE: The slot comes zeroed, so the terminator is already there
+    memcpy(name->cstr, instanceName, imini((i32)strlen(instanceName), _MD_GAME_OBJECT_NAME_LENGTH - 1));
+    info.instanceName = name->cstr;
+    info.id = GameObjectInfo::idCounter;
+    GameObjectInfo::idCounter++;
+    return info;
+}
+GameObjectInfo* GameObjectGetInfo(GameObject* obj) {
+    GameObjectStore* store = &mdEngine::gameObjectStores[obj->type];
+    return &store->info[obj - store->objects];
+}
+GameObjectHandle GameObjectGetHandle(GameObject* obj) {
+    GameObjectStore* store = &mdEngine::gameObjectStores[obj->type];
+    i32 index = (i32)(obj - store->objects);
+    return {obj->type, index, store->info[index].generation};
+}
+GameObject* GameObjectResolve(GameObjectHandle handle) {
+    if (handle.generation == 0) {
+        return nullptr;
+    }
+    GameObjectStore* store = &mdEngine::gameObjectStores[handle.type];
+    return store->info[handle.index].generation == handle.generation ? &store->objects[handle.index] : nullptr;
+}
+void* GameObjectResolveData(GameObjectHandle handle) {
+    GameObject* obj = GameObjectResolve(handle);
+    return obj != nullptr ? obj->data : nullptr;
+}
+// The object stops updating and drawing right away, but it's only freed and its slot recycled in GameObjectsDestroyDespawned
+void GameObjectDespawn(GameObjectHandle handle) {
+    GameObject* obj = GameObjectResolve(handle);
+    if (obj == nullptr || obj->_despawnQueued) {
+        return;
+    }
+    obj->_despawnQueued = true;
+    obj->active = false;
+    obj->visible = false;
+    ArenaArrayPushBack(&mdEngine::gameObjectDespawnQueue, handle);
+}
+// Call at the end of the frame
+// NOTE: The data slot, script state, instance name and waiting coroutines go back to their pools here.
+// Anything else Create reserved has to be given back by the type's Free function
+void GameObjectsDestroyDespawned() {
+    ArenaArray<GameObjectHandle>* queue = &mdEngine::gameObjectDespawnQueue;
+    for (i32 i = 0; i < queue->size; i++) {
+        GameObjectHandle handle = queue->data[i];
+        GameObject* obj = GameObjectResolve(handle);
+        GameObjectStore* store = &mdEngine::gameObjectStores[handle.type];
+        GameInstanceEventFunction free = mdEngine::gameObjectDefinitions[handle.type].Free;
+        if (free != nullptr) {
+            free(obj->data);
+        }
+        _GameObjectFreePooled(store, handle.index);
+        if (obj->UpdateScript != nullptr) {
+            store->scriptCount--;
+        }
+        GameObjectInfo* info = &store->info[handle.index];
+        u32 generation = info->generation + 1;
+        *obj = {};
+        *info = {};
+        info->generation = generation;
+        store->_freeIndices[store->_freeCount] = handle.index;
+        store->_freeCount++;
+    }
+    if (queue->size > 0) {
+        CoroutinesDestroyOrphaned();
+    }
+    ArenaArrayClear(queue);
+}
+
+// Script state is a plain struct that both scripts get a typed pointer to. It starts out zeroed.
+// States come from a pool per state type in scene memory, so despawned objects give theirs back
+template <typename State, typename T>
+void GameObjectAddScript(GameObject* obj, void(*initScript)(GameObject*, T*, State*), void(*updateScript)(GameObject*, T*, State*)) {
+    GameObjectInfo* info = GameObjectGetInfo(obj);
+    if (info->_scriptStateFree != nullptr) {
+        info->_scriptStateFree(obj->scriptState);
+    }
+    State* state = ObjectPoolAlloc(_GameObjectGetScriptStatePool<State>());
+    info->_scriptStateFree = _GameObjectScriptStateFree<State>;
+    _GameObjectAddScript(obj, state, (GameObjectScriptFunc)initScript, (GameObjectScriptFunc)updateScript);
+}
+// The pool expires with the scene, since its slabs are in scene memory
+template <typename State>
+ObjectPool<State>* _GameObjectGetScriptStatePool() {
+    local_persist ObjectPool<State> pool = {};
+    local_persist u32 sceneGeneration = 0;
+    if (sceneGeneration != mdEngine::sceneGeneration) {
+        pool = ObjectPoolCreate<State>(&mdEngine::sceneMemory);
+        sceneGeneration = mdEngine::sceneGeneration;
+    }
+    return &pool;
+}
+template <typename State>
+void _GameObjectScriptStateFree(void* state) {
+    ObjectPoolFree(_GameObjectGetScriptStatePool<State>(), (State*)state);
+}
+// Gives the instance name and script state of the object at 'index' back to their pools
+void _GameObjectFreePooled(GameObjectStore* store, i32 index) {
+    GameObject* obj = &store->objects[index];
+    GameObjectInfo* info = &store->info[index];
+    if (info->_scriptStateFree != nullptr) {
+        info->_scriptStateFree(obj->scriptState);
+        info->_scriptStateFree = nullptr;
+        obj->scriptState = nullptr;
+    }
+    if (info->instanceName != nullptr) {
+        ObjectPoolFree(&store->_names, (GameObjectName*)info->instanceName);
+        info->instanceName = nullptr;
+    }
+}
+void _GameObjectAddScript(GameObject* obj, void* state, GameObjectScriptFunc initScript, GameObjectScriptFunc updateScript) {
+    obj->scriptState = state;
+    if (initScript != nullptr) {
+        mdEngine::currentGameObjectInstance = obj;
+        initScript(obj, obj->data, state);
+        mdEngine::currentGameObjectInstance = NULL;
+    }
     // TODO: Consider adding a create function that runs once all game objects have been added
+    if (obj->UpdateScript == nullptr && updateScript != nullptr) {
+        mdEngine::gameObjectStores[obj->type].scriptCount++;
+    }
     obj->UpdateScript = updateScript;
 }
-void GameObjectsUpdate(GameObject* gameObjects, i32 gameObjectCount) {
-    for (i32 i = 0; i < gameObjectCount; i++) {
-        if (gameObjects[i].active && gameObjects[i].Update != nullptr) {
-            gameObjects[i].Update(gameObjects[i].data);
+// Calls 'batch' once for every run of consecutive instances in [start, start + count) that have the flag set
+void _GameObjectStoreDispatchBatch(GameObjectStore* store, GameInstanceBatchFunction batch, bool visibleFlag, i32 start, i32 count) {
+    i32 end = start + count;
+    i32 runStart = start;
+    for (i32 i = start; i <= end; i++) {
+        bool enabled = i < end && (visibleFlag ? store->objects[i].visible : store->objects[i].active);
+        if (enabled) {
+            continue;
         }
-        if (gameObjects[i].active && gameObjects[i].UpdateScript != nullptr) {
-            mdEngine::currentGameObjectInstance = &gameObjects[i];
-            gameObjects[i].UpdateScript(&gameObjects[i], gameObjects[i].data);
+        if (i > runStart) {
+            batch(store->data + runStart * store->stride, i - runStart);
         }
+        runStart = i + 1;
     }
-    mdEngine::currentGameObjectInstance = NULL;
 }
-void GameObjectsDraw3d(GameObject* gameObjects, i32 gameObjectCount) {
-    for (i32 i = 0; i < gameObjectCount; i++) {
-        if (gameObjects[i].visible && gameObjects[i].Draw3d != nullptr) {
-            gameObjects[i].Draw3d(gameObjects[i].data);
+void _GameObjectStoreUpdateScripts(GameObjectStore* store, i32 start, i32 count) {
+    for (i32 i = start; i < start + count; i++) {
+        GameObject* obj = &store->objects[i];
+        if (obj->active && obj->UpdateScript != nullptr) {
+            mdEngine::currentGameObjectInstance = obj;
+            obj->UpdateScript(obj, obj->data, obj->scriptState);
         }
     }
 }
-void GameObjectsDrawUi(GameObject* gameObjects, i32 gameObjectCount) {
-    for (i32 i = 0; i < gameObjectCount; i++) {
-        if (gameObjects[i].visible && gameObjects[i].DrawUi != nullptr) {
-            gameObjects[i].DrawUi(gameObjects[i].data);
+bool _GameObjectTypeHasUpdate(i32 type) {
+    GameObjectDefinition* def = &mdEngine::gameObjectDefinitions[type];
+    GameObjectStore* store = &mdEngine::gameObjectStores[type];
+    return store->count > 0 && (def->UpdateTimed != nullptr || def->UpdateBatch != nullptr || def->Update != nullptr || store->scriptCount > 0);
+}
+void GameObjectsSetUpdateOrigin(v3 origin) {
+    mdEngine::updateOrigin = origin;
+}
+i32 _GameObjectGetUpdateRateForDistance(float distanceSqr) {
+    float* distances = mdEngine::updateRateDistances;
+    if (distanceSqr < distances[0] * distances[0]) {
+        return GAME_OBJECT_UPDATE_RATE_EVERY_FRAME;
+    } else if (distanceSqr < distances[1] * distances[1]) {
+        return GAME_OBJECT_UPDATE_RATE_EVERY_2ND_FRAME;
+    } else if (distanceSqr < distances[2] * distances[2]) {
+        return GAME_OBJECT_UPDATE_RATE_EVERY_4TH_FRAME;
+    }
+    return GAME_OBJECT_UPDATE_RATE_EVERY_8TH_FRAME;
+}
+// Instance i updates on the frames where (frame + i) is a multiple of its rate, so a full store of one rate
+// updates the same number of instances every frame
+void _GameObjectStoreUpdateTimed(GameObjectStore* store, GameObjectDefinition* def, i32 start, i32 count) {
+    GameInstanceTimedFunction updateTimed = def->UpdateTimed;
+    GameInstancePositionFunction getPosition = def->GetPosition;
+    GameObject* objects = store->objects;
+    byte* data = store->data;
+    i32 stride = store->stride;
+    u32 frame = mdEngine::updateFrame;
+    v3 origin = mdEngine::updateOrigin;
+    for (i32 i = start; i < start + count; i++) {
+        GameObject* obj = &objects[i];
+        if (!obj->active) {
+            // NOTE: Keeps the stamp current so that the first update after reactivation doesn't see a wrapped frame count
+            obj->_lastUpdateFrame = (u8)frame;
+            continue;
+        }
+        void* instance = data + i * stride;
+        i32 rate = obj->updateRate;
+        if (rate == GAME_OBJECT_UPDATE_RATE_AUTO) {
+            rate = getPosition != nullptr ?
+                _GameObjectGetUpdateRateForDistance(Vector3DistanceSqr(getPosition(instance), origin)) :
+                GAME_OBJECT_UPDATE_RATE_EVERY_FRAME;
         }
+        if (((frame + (u32)i) & (u32)(rate - 1)) != 0) {
+            continue;
+        }
+        u8 elapsedFrames = (u8)((u8)frame - obj->_lastUpdateFrame);
+        obj->_lastUpdateFrame = (u8)frame;
+        updateTimed(instance, (float)elapsedFrames * FRAME_TIME);
     }
 }
-void GameObjectsFree(GameObject* gameObjects, i32 gameObjectCount) {
-    for (i32 i = 0; i < gameObjectCount; i++) {
-        if (gameObjects[i].Free != nullptr) {
-            gameObjects[i].Free(gameObjects[i].data);
+void _GameObjectStoreUpdateRange(i32 type, i32 start, i32 count) {
+    GameObjectStore* store = &mdEngine::gameObjectStores[type];
+    GameObjectDefinition* def = &mdEngine::gameObjectDefinitions[type];
+    if (def->UpdateTimed != nullptr) {
+        _GameObjectStoreUpdateTimed(store, def, start, count);
+        if (store->scriptCount > 0) {
+            _GameObjectStoreUpdateScripts(store, start, count);
+        }
+    } else if (def->UpdateBatch != nullptr) {
+        _GameObjectStoreDispatchBatch(store, def->UpdateBatch, false, start, count);
+        if (store->scriptCount > 0) {
+            _GameObjectStoreUpdateScripts(store, start, count);
         }
+    } else if (def->Update != nullptr) {
+        // NOTE: Copied to locals since the compiler can't tell that Update doesn't change them
+        GameInstanceEventFunction update = def->Update;
+        GameObject* objects = store->objects;
+        byte* data = store->data;
+        i32 stride = store->stride;
+        bool scripted = store->scriptCount > 0;
+        for (i32 i = start; i < start + count; i++) {
+            GameObject* obj = &objects[i];
+            if (!obj->active) {
+                continue;
+            }
+            update(data + i * stride);
+            if (scripted && obj->UpdateScript != nullptr) {
+                mdEngine::currentGameObjectInstance = obj;
+                obj->UpdateScript(obj, obj->data, obj->scriptState);
+            }
+        }
+    } else if (store->scriptCount > 0) {
+        _GameObjectStoreUpdateScripts(store, start, count);
     }
 }
-void GameObjectsDrawImGui(GameObject* gameObjects, i32 gameObjectCount) {
-    for (i32 i = 0; i < gameObjectCount; i++) {
-        if (gameObjects[i].DrawImGui != nullptr) {
-            if (ImGui::CollapsingHeader(TextFormat("%s - %s (%i)", gameObjects[i].objectName, gameObjects[i].instanceName, gameObjects[i].id))) {
-                gameObjects[i].DrawImGui(gameObjects[i].data);
+struct _GameObjectUpdateJob {
+    i32 type;
+    i32 start;
+    i32 count;
+};
+void _GameObjectUpdateJobRun(void* data) {
+    _GameObjectUpdateJob* job = (_GameObjectUpdateJob*)data;
+    _GameObjectStoreUpdateRange(job->type, job->start, job->count);
+}
+inline bool _GameObjectAccessConflicts(u64 readsA, u64 writesA, u64 readsB, u64 writesB) {
+    return (writesA & (readsB | writesB)) != 0 || (writesB & readsA) != 0;
+}
+#define _MD_GAME_OBJECT_UPDATE_JOB_INSTANCES 16
+// Types update in waves. A type goes into the wave after the last earlier registered type it conflicts with, so
+// conflicting types still update in registration order and the result doesn't depend on how the threads get scheduled.
+// Types that have to stay on the main thread conflict with everything and get a wave to themselves
+void GameObjectsUpdate() {
+    mdEngine::updateFrame++;
+    i32 waves[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    u64 reads[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    u64 writes[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    bool mainThread[_MD_GAME_ENGINE_OBJECT_COUNT_MAX];
+    i32 waveCount = 0;
+    for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+        i32 type = mdEngine::gameObjectTypes[t];
+        GameObjectDefinition* def = &mdEngine::gameObjectDefinitions[type];
+        waves[t] = -1;
+        if (!_GameObjectTypeHasUpdate(type)) {
+            continue;
+        }
+        mainThread[t] = def->mainThread || mdEngine::gameObjectStores[type].scriptCount > 0 || mdEngine::jobSystem.workerCount == 0;
+        reads[t] = mainThread[t] ? GAME_OBJECT_ACCESS_ALL : def->reads;
+        writes[t] = mainThread[t] ? GAME_OBJECT_ACCESS_ALL : def->writes;
+        i32 wave = 0;
+        for (i32 u = 0; u < t; u++) {
+            if (waves[u] >= wave && _GameObjectAccessConflicts(reads[t], writes[t], reads[u], writes[u])) {
+                wave = waves[u] + 1;
             }
         }
+        waves[t] = wave;
+        waveCount = imaxi(waveCount, wave + 1);
     }
+    for (i32 w = 0; w < waveCount; w++) {
+        for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+            if (waves[t] != w || mainThread[t]) {
+                continue;
+            }
+            i32 type = mdEngine::gameObjectTypes[t];
+            i32 count = mdEngine::gameObjectStores[type].count;
+            i32 chunk = mdEngine::gameObjectDefinitions[type].parallelInstances ? _MD_GAME_OBJECT_UPDATE_JOB_INSTANCES : count;
+            for (i32 start = 0; start < count; start += chunk) {
+                _GameObjectUpdateJob* job = FrameReserve<_GameObjectUpdateJob>(1);
+                *job = {type, start, imini(chunk, count - start)};
+                JobSystemPush(_GameObjectUpdateJobRun, job);
+            }
+        }
+        for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+            if (waves[t] == w && mainThread[t]) {
+                i32 type = mdEngine::gameObjectTypes[t];
+                _GameObjectStoreUpdateRange(type, 0, mdEngine::gameObjectStores[type].count);
+            }
+        }
+        JobSystemWaitAll();
+    }
+    EventHandlerFlush();
+    CoroutinesUpdate();
+    mdEngine::currentGameObjectInstance = NULL;
 }
-void InstanceVariablePush(std::string name, i32 value) {
-    _InstanceVariablePush(name, MD_TYPE_I32, &value);
-}
-void InstanceVariablePush(std::string name, byte value) {
-    _InstanceVariablePush(name, MD_TYPE_BYTE, &value);
-}
-void InstanceVariablePush(std::string name, void* value) {
-    _InstanceVariablePush(name, MD_TYPE_PTR, &value);
-}
-void InstanceVariablePush(std::string name, float value) {
-    _InstanceVariablePush(name, MD_TYPE_FLOAT, &value);
-}
-void InstanceVariablePush(std::string name, Tween value) {
-    _InstanceVariablePush(name, MD_TYPE_TWEEN, &value);
-}
-template <> i32 InstanceVariableGet(std::string name) {
-    return *(i32*)_InstanceVariableGet(name, MD_TYPE_I32);
-}
-template <> byte InstanceVariableGet(std::string name) {
-    return *(byte*)_InstanceVariableGet(name, MD_TYPE_BYTE);
-}
-template <> void* InstanceVariableGet(std::string name) {
-    return _InstanceVariableGet(name, MD_TYPE_PTR);
-}
-template <> float InstanceVariableGet(std::string name) {
-    return *(float*)_InstanceVariableGet(name, MD_TYPE_FLOAT);
-}
-template <> Tween InstanceVariableGet(std::string name) {
-    return *(Tween*)_InstanceVariableGet(name, MD_TYPE_TWEEN);
-}
-// TODO: Create some sort of global state where calling this function sets the currently scoped game instance.
-// This is to get rid of a lot of the vars passed to this function. 'obj' and 'type' can be removed enirely.
-// 'value' can be replaced with an actual typed variable. Same thing should go for GameObjectVariableGet
-void InstanceVariableSet(std::string name, i32 value) {
-    _InstanceVariableSet(name, MD_TYPE_I32, &value);
-}
-void InstanceVariableSet(std::string name, byte value) {
-    _InstanceVariableSet(name, MD_TYPE_BYTE, &value);
-}
-void InstanceVariableSet(std::string name, void* value) {
-    _InstanceVariableSet(name, MD_TYPE_PTR, &value);
+void _GameObjectsDraw(bool ui) {
+    for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+        i32 type = mdEngine::gameObjectTypesByDrawOrder[t];
+        GameObjectDefinition* def = &mdEngine::gameObjectDefinitions[type];
+        GameObjectStore* store = &mdEngine::gameObjectStores[type];
+        GameInstanceBatchFunction drawBatch = ui ? def->DrawUiBatch : def->Draw3dBatch;
+        GameInstanceEventFunction draw = ui ? def->DrawUi : def->Draw3d;
+        if (store->count == 0) {
+            continue;
+        }
+        if (drawBatch != nullptr) {
+            _GameObjectStoreDispatchBatch(store, drawBatch, true, 0, store->count);
+        } else if (draw != nullptr) {
+            for (i32 i = 0; i < store->count; i++) {
+                if (store->objects[i].visible) {
+                    draw(store->data + i * store->stride);
+                }
+            }
+        }
+        // NOTE: Flushed per type so streamed draws keep their place in the draw order
+        InstanceStreamFlush(&mdEngine::instanceStream);
+    }
 }
-void InstanceVariableSet(std::string name, float value) {
-    _InstanceVariableSet(name, MD_TYPE_FLOAT, &value);
+void GameObjectsDraw3d() {
+    _GameObjectsDraw(false);
 }
-void InstanceVariableSet(std::string name, Tween value) {
-    _InstanceVariableSet(name, MD_TYPE_TWEEN, &value);
+void GameObjectsDrawUi() {
+    _GameObjectsDraw(true);
 }
-void _InstanceVariablePush(std::string name, i32 type, void* value) {
-    GameObject* obj = mdEngine::currentGameObjectInstance;
-    if (obj->variableIndices.find(name) != obj->variableIndices.end()) {
-        const char* log = TextFormat(
-            "%s: Variable with name '%s' already exists in object '%s'",
-            nameof(GameObjectVariablePush),
-            name.c_str(),
-            obj->objectName);
-        TraceLog(LOG_WARNING, log);
-        return;
-    }
-    obj->variableIndices[name] = VariableDynamicBufferPush(&obj->variableBuffer, value, type);
-}
-void* _InstanceVariableGet(std::string name, i32 type) {
-    GameObject* obj = mdEngine::currentGameObjectInstance;
-    if (obj->variableIndices.find(name) == obj->variableIndices.end()) {
-        const char* log = TextFormat(
-            "%s: Variable with name '%s' doesn't exists in object '%s'",
-            nameof(GameObjectVariableGet),
-            name.c_str(),
-            obj->objectName);
-        TraceLog(LOG_WARNING, log);
-        return nullptr;
+void GameObjectsFree() {
+    for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+        i32 type = mdEngine::gameObjectTypes[t];
+        GameObjectStore* store = &mdEngine::gameObjectStores[type];
+        GameInstanceEventFunction free = mdEngine::gameObjectDefinitions[type].Free;
+        for (i32 i = 0; i < store->count; i++) {
+            if (free != nullptr && store->objects[i].alive) {
+                free(store->data + i * store->stride);
+            }
+        }
+        store->count = 0;
+        store->_freeCount = 0;
+        store->_names = {}; // Recreated from the next scene's memory pool
+        // NOTE: Keeps the address space so that the next scene starts with the same arrays
+        if (store->objects != nullptr) {
+            MemoryPoolClear(&store->_objectsMemory);
+            MemoryPoolClear(&store->_infoMemory);
+            MemoryPoolClear(&store->_freeIndicesMemory);
+        }
+        if (store->data != nullptr) {
+            MemoryPoolClear(&store->_dataMemory);
+        }
     }
-    return VariableDynamicBufferGet(
-        &obj->variableBuffer,
-        obj->variableIndices[name],
-        type);
-}
-void _InstanceVariableSet(std::string name, i32 type, void* value) {
-    GameObject* obj = mdEngine::currentGameObjectInstance;
-    if (obj->variableIndices.find(name) == obj->variableIndices.end()) {
-        const char* log = TextFormat(
-            "%s: Variable with name '%s' doesn't exists in object '%s'",
-            nameof(GameObjectVariableGet),
-            name.c_str(),
-            obj->objectName);
-        TraceLog(LOG_WARNING, log);
-        return;
+    EventHandlerClearQueues();
+    CoroutinesClear();
+    mdEngine::sceneGeneration++;
+}
+void GameObjectsDrawImGui() {
+    for (i32 t = 0; t < mdEngine::gameObjectTypeCount; t++) {
+        i32 type = mdEngine::gameObjectTypes[t];
+        GameObjectStore* store = &mdEngine::gameObjectStores[type];
+        GameInstanceEventFunction drawImGui = mdEngine::gameObjectDefinitions[type].DrawImGui;
+        if (drawImGui == nullptr) {
+            continue;
+        }
+        for (i32 i = 0; i < store->count; i++) {
+            GameObject* obj = &store->objects[i];
+            if (!obj->alive || obj->_despawnQueued) {
+                continue;
+            }
+            GameObjectInfo* info = &store->info[i];
+            if (ImGui::CollapsingHeader(TextFormat("%s - %s (%i)", info->objectName, info->instanceName, info->id))) {
+                ImGui::PushID(info->id);
+                drawImGui(obj->data);
+                if (ImGui::Button("Despawn")) {
+                    GameObjectDespawn(GameObjectGetHandle(obj));
+                }
+                ImGui::PopID();
+            }
+        }
     }
-    VariableDynamicBufferSet(&obj->variableBuffer, obj->variableIndices[name], type, value);
 }
-
 void StringListInit(StringList* list, i32 size, MemoryPool* mp) {
     if (size == 0) {
         list->data = nullptr;
@@ -2006,13 +3616,7 @@ void StringListAdd(StringList* list, const char* cstr) {
         TraceLog(LOG_ERROR, "StringList: Out of strings");
         return;
     }
-    String* data = (String*)list->data;
-    i32 cstrLen = (i32)strlen(cstr);
-    String* str = data + list->size;
-    str->cstr = MemoryReserve<char>(list->_memoryPool, cstrLen + 1);
-    str->length = cstrLen;
-    strcpy_s(str->cstr, cstrLen + 1, cstr);
-    str->cstr[cstrLen] = '\0';
+    list->data[list->size] = StringCreate(cstr, list->_memoryPool);
     list->size++;
 }
 String* StringListGet(StringList* list, i32 ind) {
@@ -2023,191 +3627,508 @@ String* StringListGet(StringList* list, i32 ind) {
     return list->data + ind;
 }
 
-EventHandler EventHandlerCreate() {
-    EventHandler eh = {};
+void EventHandlerInit(EventHandler* eh, MemoryPool* mp) {
+    *eh = {};
     for (i32 i = 0; i < EVENT_COUNT; i++) {
-        eh.callbacks[i] = TypeListCreate(MD_TYPE_PTR, &mdEngine::persistentMemory);
-        eh.registrars[i] = TypeListCreate(MD_TYPE_PTR, &mdEngine::persistentMemory);
+        ArenaArrayInit(&eh->listeners[i], mp);
+        ArenaArrayInit(&eh->slots[i], mp);
+        ArenaArrayInit(&eh->freeSlots[i], mp);
+        assert(eventArgsSizes[i] <= _MD_EVENT_ARGS_SIZE_MAX);
+        eh->queues[i].args = MemoryReserve<byte>(mp, _MD_EVENT_QUEUE_CAPACITY * eventArgsSizes[i]);
+        eh->queues[i].senders = MemoryReserve<void*>(mp, _MD_EVENT_QUEUE_CAPACITY);
+    }
+    ArenaArrayInit(&eh->_unregisterQueue, mp);
+    eh->threadQueue = MemoryReserveAligned<_EventThreadQueue>(mp, 1, CACHE_LINE_SIZE);
+    for (u32 i = 0; i < _MD_EVENT_THREAD_QUEUE_CAPACITY; i++) {
+        eh->threadQueue->slots[i].sequence.store(i, std::memory_order_relaxed);
     }
-    return eh;
 }
-void EventHandlerRegisterEvent(i32 ind, void* registrar, EventCallbackSignature callback) {
+// Only call from the main thread
+EventListenerHandle EventHandlerRegisterEvent(i32 ind, void* registrar, EventCallbackSignature callback, void* sender) {
     assert(ind < EVENT_COUNT); // event doesn't exist
-    assert(TypeListFindPtr(mdEngine::eventHandler.registrars[ind], registrar) == -1); // event already registered
-    TypeListPushBackPtr(mdEngine::eventHandler.callbacks[ind], callback);
-    TypeListPushBackPtr(mdEngine::eventHandler.registrars[ind], registrar);
+    EventHandler* eh = &mdEngine::eventHandler;
+    i32 slot = -1;
+    if (eh->freeSlots[ind].size > 0) {
+        slot = eh->freeSlots[ind].data[eh->freeSlots[ind].size - 1];
+        eh->freeSlots[ind].size--;
+    } else {
+        slot = eh->slots[ind].size;
+        ArenaArrayPushBack(&eh->slots[ind], {-1, 0});
+    }
+    _EventListenerSlot* listenerSlot = ArenaArrayGet(&eh->slots[ind], slot);
+    listenerSlot->listenerIndex = eh->listeners[ind].size;
+    listenerSlot->generation++;
+    ArenaArrayPushBack(&eh->listeners[ind], {registrar, sender, callback, slot});
+    return {ind, slot, listenerSlot->generation};
+}
+template <typename R, typename T>
+EventListenerHandle EventHandlerRegister(R* registrar, void(*callback)(R*, T*), void* sender) {
+    return EventHandlerRegisterEvent(T::eventIndex, (void*)registrar, (EventCallbackSignature)callback, sender);
+}
+// Safe to call from a listener. The listener is then removed once the flush is done and doesn't get called again
+void EventHandlerUnregisterEvent(EventListenerHandle handle) {
+    EventHandler* eh = &mdEngine::eventHandler;
+    if (handle.generation == 0 || handle.slot >= eh->slots[handle.ind].size) {
+        return;
+    }
+    _EventListenerSlot* slot = &eh->slots[handle.ind].data[handle.slot];
+    if (slot->generation != handle.generation || slot->listenerIndex == -1) {
+        return;
+    }
+    if (eh->_dispatching) {
+        EventListener* listener = &eh->listeners[handle.ind].data[slot->listenerIndex];
+        if (listener->callback != nullptr) {
+            listener->callback = nullptr;
+            ArenaArrayPushBack(&eh->_unregisterQueue, handle);
+        }
+    } else {
+        _EventHandlerRemoveListener(handle);
+    }
 }
-void EventHandlerUnregisterEvent(i32 ind, void* registrar) {
-    assert(ind < EVENT_COUNT);
-    assert(TypeListFindPtr(mdEngine::eventHandler.registrars[ind], registrar) != -1);
-    // TODO: remove event
+void _EventHandlerRemoveListener(EventListenerHandle handle) {
+    EventHandler* eh = &mdEngine::eventHandler;
+    ArenaArray<EventListener>* listeners = &eh->listeners[handle.ind];
+    _EventListenerSlot* slot = &eh->slots[handle.ind].data[handle.slot];
+    i32 last = listeners->size - 1;
+    if (slot->listenerIndex != last) {
+        listeners->data[slot->listenerIndex] = listeners->data[last];
+        eh->slots[handle.ind].data[listeners->data[last]._slot].listenerIndex = slot->listenerIndex;
+    }
+    listeners->size--;
+    slot->listenerIndex = -1;
+    ArenaArrayPushBack(&eh->freeSlots[handle.ind], handle.slot);
+}
+template <typename T>
+void EventHandlerPost(void* sender, T args) {
+    EventHandlerPostEvent(sender, T::eventIndex, &args);
 }
-void EventHandlerCallEvent(void* caller, i32 ind, void* _args) {
+// Can be called from any thread. 'args' is copied, so it only has to live for the call
+void EventHandlerPostEvent(void* sender, i32 ind, void* args) {
     assert(ind < EVENT_COUNT);
-    TypeList* registrars = mdEngine::eventHandler.registrars[ind];
-    TypeList* callbacks = mdEngine::eventHandler.callbacks[ind];
-    for (i32 i = 0; i < registrars->size; i++) {
-        switch(ind) {
-            case EVENT_TYPEWRITER_LINE_COMPLETE: {
-                EventArgs_TypewriterLineComplete* args = (EventArgs_TypewriterLineComplete*)_args;
-                EventCallbackSignature_TypewriterLineComplete callback = (EventCallbackSignature_TypewriterLineComplete)TypeListGetPtr(callbacks, i);
-                callback(TypeListGetPtr(registrars, i), args);
+    EventHandler* eh = &mdEngine::eventHandler;
+    if (std::this_thread::get_id() != mdEngine::mainThreadId) {
+        if (!_EventThreadQueuePush(eh->threadQueue, ind, sender, args)) {
+            eh->threadQueue->writer.droppedCount++;
+        }
+    } else if (!_EventQueuePush(&eh->queues[ind], ind, sender, args)) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Event queue is full, dropped event %i", nameof(EventHandlerPostEvent), ind));
+    }
+}
+bool _EventQueuePush(EventQueue* queue, i32 ind, void* sender, void* args) {
+    if (queue->count == _MD_EVENT_QUEUE_CAPACITY) {
+        return false;
+    }
+    i32 index = (queue->head + queue->count) % _MD_EVENT_QUEUE_CAPACITY;
+    memcpy(queue->args + index * eventArgsSizes[ind], args, eventArgsSizes[ind]);
+    queue->senders[index] = sender;
+    queue->count++;
+    return true;
+}
+// Each slot's sequence says whose turn it is. It equals the write index while the slot is free
+// and the write index + 1 once the slot has been written and can be read
+bool _EventThreadQueuePush(_EventThreadQueue* queue, i32 ind, void* sender, void* args) {
+    u32 position = queue->writer.index.load(std::memory_order_relaxed);
+    _EventThreadQueueSlot* slot = nullptr;
+    while (true) {
+        slot = &queue->slots[position & (_MD_EVENT_THREAD_QUEUE_CAPACITY - 1)];
+        i32 difference = (i32)(slot->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0) {
+            if (queue->writer.index.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
                 break;
             }
-            case EVENT_DIALOGUE_OPTIONS_SELECTED: {
-                EventArgs_DialogueOptionsSelected* args = (EventArgs_DialogueOptionsSelected*)_args;
-                EventCallbackSignature_DialogueOptionsSelected callback = (EventCallbackSignature_DialogueOptionsSelected)TypeListGetPtr(callbacks, i);
-                callback(TypeListGetPtr(registrars, i), args);
-                break;
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = queue->writer.index.load(std::memory_order_relaxed);
+        }
+    }
+    slot->ind = ind;
+    slot->sender = sender;
+    memcpy(slot->args, args, eventArgsSizes[ind]);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+bool _EventThreadQueuePop(_EventThreadQueue* queue, i32* ind, void** sender, void* args) {
+    _EventThreadQueueSlot* slot = &queue->slots[queue->reader.index & (_MD_EVENT_THREAD_QUEUE_CAPACITY - 1)];
+    if (slot->sequence.load(std::memory_order_acquire) != queue->reader.index + 1) {
+        return false;
+    }
+    *ind = slot->ind;
+    *sender = slot->sender;
+    memcpy(args, slot->args, eventArgsSizes[slot->ind]);
+    slot->sequence.store(queue->reader.index + _MD_EVENT_THREAD_QUEUE_CAPACITY, std::memory_order_release);
+    queue->reader.index++;
+    return true;
+}
+struct _EventThreadEvent {
+    i32 ind;
+    void* sender;
+    byte args[_MD_EVENT_ARGS_SIZE_MAX];
+};
+// Call once per frame on the main thread after everything that posts events has finished.
+// Events posted from other threads get sorted by sender, so the order doesn't depend on how the jobs got scheduled.
+// Events posted by listeners are dispatched in another pass, up to _MD_EVENT_FLUSH_PASSES_MAX, and the rest wait for the next flush
+void EventHandlerFlush() {
+    EventHandler* eh = &mdEngine::eventHandler;
+    {
+        ScratchScope scratch(&mdEngine::scratchMemory, false);
+        _EventThreadEvent* events = MemoryReserve<_EventThreadEvent>(scratch.memoryPool, _MD_EVENT_THREAD_QUEUE_CAPACITY);
+        i32 eventCount = 0;
+        _EventThreadEvent event = {};
+        while (eventCount < _MD_EVENT_THREAD_QUEUE_CAPACITY && _EventThreadQueuePop(eh->threadQueue, &event.ind, &event.sender, event.args)) {
+            // Insertion sort keeps events from the same sender in the order they were posted
+            i32 i = eventCount;
+            while (i > 0 && (uintptr_t)events[i - 1].sender > (uintptr_t)event.sender) {
+                events[i] = events[i - 1];
+                i--;
+            }
+            events[i] = event;
+            eventCount++;
+        }
+        for (i32 i = 0; i < eventCount; i++) {
+            if (!_EventQueuePush(&eh->queues[events[i].ind], events[i].ind, events[i].sender, events[i].args)) {
+                TraceLog(LOG_WARNING, TextFormat("%s: Event queue is full, dropped event %i", nameof(EventHandlerFlush), events[i].ind));
             }
         }
+        i32 droppedCount = eh->threadQueue->writer.droppedCount.exchange(0);
+        if (droppedCount > 0) {
+            TraceLog(LOG_WARNING, TextFormat("%s: Thread event queue was full, dropped %i events", nameof(EventHandlerFlush), droppedCount));
+        }
+    }
+    for (i32 pass = 0; pass < _MD_EVENT_FLUSH_PASSES_MAX; pass++) {
+        bool dispatched = false;
+        eh->_dispatching = true;
+        for (i32 ind = 0; ind < EVENT_COUNT; ind++) {
+            EventQueue* queue = &eh->queues[ind];
+            // NOTE: Only the events that were queued when the pass started. Listeners can add more
+            i32 count = queue->count;
+            if (count > 0) {
+                mdEngine::coroutineScheduler.eventCalled[ind] = true;
+                dispatched = true;
+            }
+            for (i32 e = 0; e < count; e++) {
+                void* args = queue->args + queue->head * eventArgsSizes[ind];
+                void* sender = queue->senders[queue->head];
+                ArenaArray<EventListener>* listeners = &eh->listeners[ind];
+                for (i32 i = 0; i < listeners->size; i++) {
+                    EventListener* listener = &listeners->data[i];
+                    if (listener->callback != nullptr && (listener->sender == nullptr || listener->sender == sender)) {
+                        listener->callback(listener->registrar, args);
+                    }
+                }
+                queue->head = (queue->head + 1) % _MD_EVENT_QUEUE_CAPACITY;
+                queue->count--;
+            }
+        }
+        eh->_dispatching = false;
+        for (i32 i = 0; i < eh->_unregisterQueue.size; i++) {
+            _EventHandlerRemoveListener(eh->_unregisterQueue.data[i]);
+        }
+        ArenaArrayClear(&eh->_unregisterQueue);
+        if (!dispatched) {
+            break;
+        }
     }
 }
-
-TypeList* TypeListCreate(i32 typeIndex, MemoryPool* mp, i32 capacity) {
-    TypeList* list = MemoryReserve<TypeList>(mp);
-    list->memoryProvider = mp;
-    list->typeIndex = typeIndex;
-    list->bufferStride = MdTypeGetSize(typeIndex);
-    list->size = 0;
-    list->capacity = 0;
-    TypeListSetCapacity(list, capacity);
-    return list;
+// Drops every event that hasn't been dispatched yet
+void EventHandlerClearQueues() {
+    EventHandler* eh = &mdEngine::eventHandler;
+    for (i32 i = 0; i < EVENT_COUNT; i++) {
+        eh->queues[i].head = 0;
+        eh->queues[i].count = 0;
+    }
+    i32 ind = 0;
+    void* sender = nullptr;
+    byte args[_MD_EVENT_ARGS_SIZE_MAX];
+    while (_EventThreadQueuePop(eh->threadQueue, &ind, &sender, args)) {}
+}
+
+void* CoroutinePromise::operator new(size_t size) {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    MemoryTagScope tag(&mdEngine::sceneMemory, MEMORY_TAG_COROUTINES);
+    if (size <= _MD_COROUTINE_FRAME_SIZE_SMALL) {
+        return ObjectPoolAlloc(&cs->_framesSmall);
+    } else if (size <= _MD_COROUTINE_FRAME_SIZE_MEDIUM) {
+        return ObjectPoolAlloc(&cs->_framesMedium);
+    } else if (size <= _MD_COROUTINE_FRAME_SIZE_LARGE) {
+        return ObjectPoolAlloc(&cs->_framesLarge);
+    }
+    return MemoryReserveAligned<byte>(&mdEngine::sceneMemory, size, alignof(std::max_align_t));
+}
+// NOTE: Gets the same size that was passed to operator new, so the frame goes back to the pool it came from
+void CoroutinePromise::operator delete(void* ptr, size_t size) {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    if (size <= _MD_COROUTINE_FRAME_SIZE_SMALL) {
+        ObjectPoolFree(&cs->_framesSmall, (_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_SMALL>*)ptr);
+    } else if (size <= _MD_COROUTINE_FRAME_SIZE_MEDIUM) {
+        ObjectPoolFree(&cs->_framesMedium, (_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_MEDIUM>*)ptr);
+    } else if (size <= _MD_COROUTINE_FRAME_SIZE_LARGE) {
+        ObjectPoolFree(&cs->_framesLarge, (_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_LARGE>*)ptr);
+    }
 }
-void TypeListSetCapacity(TypeList* list, i32 capacity) {
-    if (capacity < 0) {
-        TraceLog(LOG_WARNING, "%s: Tried changing capacity to below 0", nameof(TypeList));
-        assert(false);
-        return;
+void WaitSeconds::await_suspend(std::coroutine_handle<CoroutinePromise> handle) {
+    _CoroutineSleep(handle, (u64)ceilf(seconds * FRAMERATE));
+}
+void NextFrame::await_suspend(std::coroutine_handle<CoroutinePromise> handle) {
+    _CoroutineSleep(handle, 1);
+}
+void Event::await_suspend(std::coroutine_handle<CoroutinePromise> handle) {
+    assert(ind < EVENT_COUNT);
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    ArenaArrayPushBack(&cs->eventWaiting[ind], {handle, 0, cs->_order++});
+}
+void CoroutineSchedulerInit(CoroutineScheduler* cs, MemoryPool* mp) {
+    ArenaArrayInit(&cs->sleeping, mp, 64);
+    ArenaArrayInit(&cs->_resuming, mp, 64);
+    for (i32 i = 0; i < EVENT_COUNT; i++) {
+        ArenaArrayInit(&cs->eventWaiting[i], mp);
+        cs->eventCalled[i] = false;
     }
-    if (capacity < list->size) {
-        TraceLog(LOG_WARNING, "%s: Tried changing capacity to less than list size", nameof(TypeList));
-        assert(false);
-        return;
+    cs->frame = 0;
+    cs->_order = 0;
+    _CoroutineSchedulerResetFrames(cs);
+}
+// NOTE: Frames live in scene memory no matter which pool the scheduler itself is in
+void _CoroutineSchedulerResetFrames(CoroutineScheduler* cs) {
+    cs->_framesSmall = ObjectPoolCreate<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_SMALL>>(&mdEngine::sceneMemory, 64);
+    cs->_framesMedium = ObjectPoolCreate<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_MEDIUM>>(&mdEngine::sceneMemory, 32);
+    cs->_framesLarge = ObjectPoolCreate<_CoroutineFrame<_MD_COROUTINE_FRAME_SIZE_LARGE>>(&mdEngine::sceneMemory, 8);
+}
+// Runs the script right away until its first co_await
+template <typename T>
+void GameObjectStartCoroutine(GameObject* obj, Coroutine(*script)(GameObject*, T*)) {
+    _GameObjectStartCoroutine(obj, script(obj, (T*)obj->data));
+}
+void _GameObjectStartCoroutine(GameObject* obj, Coroutine co) {
+    co.handle.promise().owner = GameObjectGetHandle(obj);
+    mdEngine::currentGameObjectInstance = obj;
+    co.handle.resume();
+    mdEngine::currentGameObjectInstance = NULL;
+}
+bool _CoroutineWaiterBefore(_CoroutineWaiter a, _CoroutineWaiter b) {
+    return a.wakeFrame < b.wakeFrame || (a.wakeFrame == b.wakeFrame && a.order < b.order);
+}
+void _CoroutineSleep(std::coroutine_handle<CoroutinePromise> handle, u64 frames) {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    ArenaArray<_CoroutineWaiter>* heap = &cs->sleeping;
+    _CoroutineWaiter waiter = {handle, cs->frame + (frames > 0 ? frames : 1), cs->_order++};
+    ArenaArrayPushBack(heap, waiter);
+    i32 i = heap->size - 1;
+    while (i > 0 && _CoroutineWaiterBefore(waiter, heap->data[(i - 1) / 2])) {
+        heap->data[i] = heap->data[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
-    if (capacity == 0) {
-        list->buffer = nullptr;
-        list->capacity = capacity;
-        return;
+    heap->data[i] = waiter;
+}
+_CoroutineWaiter _CoroutineSleepingPop(ArenaArray<_CoroutineWaiter>* heap) {
+    _CoroutineWaiter top = heap->data[0];
+    _CoroutineWaiter last = heap->data[heap->size - 1];
+    heap->size--;
+    if (heap->size > 0) {
+        _CoroutineSleepingSiftDown(heap, 0, last);
     }
-    if (capacity > 0 && capacity != list->capacity) {
-        if (capacity < list->capacity) {
-            list->capacity = capacity;
-        } else {
-            void* newBuffer = MemoryPoolReserve(list->memoryProvider, capacity * list->bufferStride);
-            memcpy(newBuffer, list->buffer, list->bufferStride * list->size);
-            list->buffer = newBuffer;
-            list->capacity = capacity;
+    return top;
+}
+// Moves 'waiter' down from 'i' until both children wake up after it
+void _CoroutineSleepingSiftDown(ArenaArray<_CoroutineWaiter>* heap, i32 i, _CoroutineWaiter waiter) {
+    while (true) {
+        i32 child = i * 2 + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size && _CoroutineWaiterBefore(heap->data[child + 1], heap->data[child])) {
+            child++;
         }
+        if (!_CoroutineWaiterBefore(heap->data[child], waiter)) {
+            break;
+        }
+        heap->data[i] = heap->data[child];
+        i = child;
     }
-}
-void TypeListGrowCapacityIfLimitReached(TypeList* list) {
-    if (list->capacity == list->size) {
-        if (list->capacity == 0) {
-            TypeListSetCapacity(list, 5);
-        } else {
-            TypeListSetCapacity(list, list->capacity * 5);
+    heap->data[i] = waiter;
+}
+// Call once per frame on the main thread. Coroutines woken by events resume first, then the ones whose sleep ran out.
+// Coroutines whose object has been despawned get destroyed instead of resumed
+void CoroutinesUpdate() {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    cs->frame++;
+    ArenaArrayClear(&cs->_resuming);
+    for (i32 i = 0; i < EVENT_COUNT; i++) {
+        if (!cs->eventCalled[i]) {
+            continue;
         }
+        cs->eventCalled[i] = false;
+        ArenaArrayPushBackMany(&cs->_resuming, cs->eventWaiting[i].data, cs->eventWaiting[i].size);
+        ArenaArrayClear(&cs->eventWaiting[i]);
     }
-}
-void TypeListResize(TypeList* list, i32 size) {
-    if (size > list->capacity) {
-        TypeListSetCapacity(list, size);
-    } else if (size < list->size) {
-        memset((void*)((byte*)list->buffer + size), 0, list->size - size);
+    while (cs->sleeping.size > 0 && cs->sleeping.data[0].wakeFrame <= cs->frame) {
+        ArenaArrayPushBack(&cs->_resuming, _CoroutineSleepingPop(&cs->sleeping));
     }
-    list->size = size;
+    // NOTE: Resumed coroutines can go back to sleep, which only ever lands them in a later frame
+    for (i32 i = 0; i < cs->_resuming.size; i++) {
+        std::coroutine_handle<CoroutinePromise> handle = cs->_resuming.data[i].handle;
+        GameObject* owner = GameObjectResolve(handle.promise().owner);
+        if (owner == nullptr) {
+            handle.destroy();
+            continue;
+        }
+        mdEngine::currentGameObjectInstance = owner;
+        handle.resume();
+    }
+    mdEngine::currentGameObjectInstance = NULL;
 }
-void TypeListPushBackI32(TypeList* list, i32 val) {
-    assert(list->typeIndex == MD_TYPE_I32);
-    TypeListGrowCapacityIfLimitReached(list);
-    ((i32*)list->buffer)[list->size] = val;
-    list->size++;
+// Destroys every waiting coroutine. The frame pools start over, since their slabs go away with the scene memory
+void CoroutinesClear() {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    for (i32 i = 0; i < cs->sleeping.size; i++) {
+        cs->sleeping.data[i].handle.destroy();
+    }
+    ArenaArrayClear(&cs->sleeping);
+    ArenaArrayClear(&cs->_resuming);
+    for (i32 i = 0; i < EVENT_COUNT; i++) {
+        for (i32 j = 0; j < cs->eventWaiting[i].size; j++) {
+            cs->eventWaiting[i].data[j].handle.destroy();
+        }
+        ArenaArrayClear(&cs->eventWaiting[i]);
+        cs->eventCalled[i] = false;
+    }
+    _CoroutineSchedulerResetFrames(cs);
 }
-i32 TypeListGetI32(TypeList* list, i32 ind) {
-    assert(list->typeIndex == MD_TYPE_I32);
-    assert(ind < list->size);
-    return ((i32*)list->buffer)[ind];
-}
-void TypeListSetI32(TypeList* list, i32 ind, i32 val) {
-    assert(list->typeIndex == MD_TYPE_I32);
-    assert(ind < list->size);
-    ((i32*)list->buffer)[ind] = val;
-}
-i32 TypeListFindI32(TypeList* list, i32 val) {
-    assert(list->typeIndex == MD_TYPE_I32);
-    i32* buffer = (i32*)list->buffer;
-    for (i32 i = 0; i < list->size; i++) {
-        if (buffer[i] == val) {
-            return i;
+// Destroys the waiting coroutines of despawned objects. Otherwise ones waiting on an event that never comes would stay forever
+void CoroutinesDestroyOrphaned() {
+    CoroutineScheduler* cs = &mdEngine::coroutineScheduler;
+    for (i32 i = 0; i < EVENT_COUNT; i++) {
+        _CoroutineWaitersDestroyOrphaned(&cs->eventWaiting[i]);
+    }
+    if (_CoroutineWaitersDestroyOrphaned(&cs->sleeping)) {
+        ArenaArray<_CoroutineWaiter>* heap = &cs->sleeping;
+        for (i32 i = heap->size / 2 - 1; i >= 0; i--) {
+            _CoroutineSleepingSiftDown(heap, i, heap->data[i]);
         }
     }
-    return -1;
 }
-void TypeListPushBackPtr(TypeList* list, void* val) {
-    assert(list->typeIndex == MD_TYPE_PTR);
-    _TypeListPushBackPtr(list, val);
+// Keeps the rest in order. Returns whether anything was destroyed
+bool _CoroutineWaitersDestroyOrphaned(ArenaArray<_CoroutineWaiter>* waiters) {
+    i32 kept = 0;
+    for (i32 i = 0; i < waiters->size; i++) {
+        _CoroutineWaiter waiter = waiters->data[i];
+        if (GameObjectResolve(waiter.handle.promise().owner) == nullptr) {
+            waiter.handle.destroy();
+            continue;
+        }
+        waiters->data[kept] = waiter;
+        kept++;
+    }
+    bool destroyed = kept < waiters->size;
+    ArenaArrayResize(waiters, kept);
+    return destroyed;
 }
-void* TypeListGetPtr(TypeList* list, i32 ind) {
-    assert(list->typeIndex == MD_TYPE_PTR);
-    assert(ind < list->size);
-    return _TypeListGetPtr(list, ind);
+
+template <typename T>
+ArenaArray<T>* ArenaArrayCreate(MemoryPool* mp, i32 capacity) {
+    ArenaArray<T>* arr = MemoryReserve<ArenaArray<T>>(mp);
+    ArenaArrayInit(arr, mp, capacity);
+    return arr;
 }
-void TypeListSetPtr(TypeList* list, i32 ind, void* val) {
-    assert(list->typeIndex == MD_TYPE_PTR);
-    assert(ind < list->size);
-    _TypeListSetPtr(list, ind, val);
+template <typename T>
+void ArenaArrayInit(ArenaArray<T>* arr, MemoryPool* mp, i32 capacity) {
+    arr->data = nullptr;
+    arr->size = 0;
+    arr->capacity = 0;
+    arr->memoryPool = mp;
+    ArenaArrayReserve(arr, capacity);
+}
+// Makes room for at least 'capacity' elements. Never shrinks
+template <typename T>
+void ArenaArrayReserve(ArenaArray<T>* arr, i32 capacity) {
+    if (capacity <= arr->capacity) {
+        return;
+    }
+    if (arr->data != nullptr && MemoryPoolExtend(arr->memoryPool, arr->data, arr->capacity * sizeof(T), capacity * sizeof(T))) {
+        arr->capacity = capacity;
+        return;
+    }
+    T* dataNew = MemoryReserve<T>(arr->memoryPool, capacity);
+    if (arr->size > 0) {
+        memcpy(dataNew, arr->data, arr->size * sizeof(T));
+    }
+    arr->data = dataNew;
+    arr->capacity = capacity;
 }
-i32 TypeListFindPtr(TypeList* list, void* val) {
-    assert(list->typeIndex == MD_TYPE_PTR);
-    return _TypeListFindPtr(list, val);
+inline i32 _ArenaArrayGetGrowCapacity(i32 capacity, i32 required) {
+    i32 capacityNew = capacity > 0 ? capacity * 2 : 8;
+    return capacityNew > required ? capacityNew : required;
 }
-void _TypeListPushBackPtr(TypeList* list, void* val) {
-    TypeListGrowCapacityIfLimitReached(list);
-    ((void**)list->buffer)[list->size] = val;
-    list->size++;
+template <typename T>
+void ArenaArrayResize(ArenaArray<T>* arr, i32 size) {
+    assert(size >= 0);
+    if (size > arr->capacity) {
+        ArenaArrayReserve(arr, _ArenaArrayGetGrowCapacity(arr->capacity, size));
+    } else if (size < arr->size) {
+        for (i32 i = size; i < arr->size; i++) {
+            arr->data[i] = T{};
+        }
+    }
+    arr->size = size;
 }
-void* _TypeListGetPtr(TypeList* list, i32 ind) {
-    return ((void**)list->buffer)[ind];
+// Keeps the capacity, so the memory gets reused by the next pushes
+template <typename T>
+void ArenaArrayClear(ArenaArray<T>* arr) {
+    ArenaArrayResize(arr, 0);
 }
-void _TypeListSetPtr(TypeList* list, i32 ind, void* val) {
-    ((void**)list->buffer)[ind] = val;
+template <typename T>
+T* ArenaArrayPushBack(ArenaArray<T>* arr, T val) {
+    if (arr->size == arr->capacity) {
+        ArenaArrayReserve(arr, _ArenaArrayGetGrowCapacity(arr->capacity, arr->size + 1));
+    }
+    T* element = arr->data + arr->size;
+    *element = val;
+    arr->size++;
+    return element;
 }
-i32 _TypeListFindPtr(TypeList* list, void* val) {
-    void** buffer = (void**)list->buffer;
-    for (i32 i = 0; i < list->size; i++) {
-        if (buffer[i] == val) {
-            return i;
-        }
+template <typename T>
+T* ArenaArrayPushBackMany(ArenaArray<T>* arr, const T* vals, i32 count) {
+    assert(count >= 0);
+    if (arr->size + count > arr->capacity) {
+        ArenaArrayReserve(arr, _ArenaArrayGetGrowCapacity(arr->capacity, arr->size + count));
     }
-    return -1;
+    T* elements = arr->data + arr->size;
+    memcpy(elements, vals, count * sizeof(T));
+    arr->size += count;
+    return elements;
 }
-void TypeListPushBackGameObjectDefinition(TypeList* list, GameObjectDefinition val) {
-    assert(list->typeIndex == MD_TYPE_GAME_OBJECT_DEFINITION);
-    TypeListGrowCapacityIfLimitReached(list);
-    ((GameObjectDefinition*)list->buffer)[list->size] = val;
-    list->size++;
+template <typename T>
+T* ArenaArrayGet(ArenaArray<T>* arr, i32 ind) {
+    assert(ind >= 0 && ind < arr->size);
+    return arr->data + ind;
 }
-GameObjectDefinition* TypeListGetGameObjectDefinition(TypeList* list, i32 ind) {
-    assert(list->typeIndex == MD_TYPE_GAME_OBJECT_DEFINITION);
-    assert(ind < list->size);
-    return &((GameObjectDefinition*)list->buffer)[ind];
-}
-void TypeListSetGameObjectDefinition(TypeList* list, i32 ind, GameObjectDefinition val) {
-    assert(list->typeIndex == MD_TYPE_GAME_OBJECT_DEFINITION);
-    assert(ind < list->size);
-    ((GameObjectDefinition*)list->buffer)[ind] = val;
-}
-i32 TypeListFindGameObjectDefinitionShallow(TypeList* list, GameObjectDefinition* val) {
-    assert(list->typeIndex == MD_TYPE_GAME_OBJECT_DEFINITION);
-    GameObjectDefinition* buffer = (GameObjectDefinition*)list->buffer;
-    for (i32 i = 0; i < list->size; i++) {
-        if (buffer + i == val) {
+template <typename T>
+i32 ArenaArrayFind(ArenaArray<T>* arr, T val) {
+    for (i32 i = 0; i < arr->size; i++) {
+        if (memcmp(arr->data + i, &val, sizeof(T)) == 0) {
             return i;
         }
     }
     return -1;
 }
+// Keeps the order of the remaining elements
+template <typename T>
+void ArenaArrayErase(ArenaArray<T>* arr, i32 ind, i32 count) {
+    assert(ind >= 0 && count >= 0 && ind + count <= arr->size);
+    memmove(arr->data + ind, arr->data + ind + count, (arr->size - ind - count) * sizeof(T));
+    arr->size -= count;
+    for (i32 i = arr->size; i < arr->size + count; i++) {
+        arr->data[i] = T{};
+    }
+}
+// Moves the last element into the hole instead of shifting everything after it
+template <typename T>
+void ArenaArrayEraseSwap(ArenaArray<T>* arr, i32 ind) {
+    assert(ind >= 0 && ind < arr->size);
+    arr->size--;
+    arr->data[ind] = arr->data[arr->size];
+    arr->data[arr->size] = T{};
+}
 
 void TypewriterInit(Typewriter* tw) {
     tw->text = nullptr;
@@ -2269,20 +4190,20 @@ void _TypewriterReset(Typewriter *tw) {
 // TODO: optimize by only measuring text when the rendered string changes
 void TypewriterDraw(void* _tw) {
     Typewriter* tw = (Typewriter*)_tw;
-    String substr = StringSubstr(tw->text[tw->textIndex], 0, (i32)tw->progress);
+    StringView substr = StringSubstr(tw->text[tw->textIndex], 0, (i32)tw->progress);
+    char* text = StringViewToCstr(substr, MdEngineGetFrameMemory());
     v2 textAlign = MeasureTextEx(
         tw->textDrawingStyle.font,
-        substr.cstr,
+        text,
         tw->textDrawingStyle.size,
         tw->textDrawingStyle.charSpacing) / 2.f;
-    DrawTextPro(tw->textDrawingStyle.font, substr.cstr, {truncf((float)tw->x), truncf((float)tw->y)}, textAlign, 0.f, tw->textDrawingStyle.size, 1.f, WHITE);
-    StringDestroy(substr);
+    DrawTextPro(tw->textDrawingStyle.font, text, {truncf((float)tw->x), truncf((float)tw->y)}, textAlign, 0.f, tw->textDrawingStyle.size, 1.f, WHITE);
 }
 void TypewriterEvent_LineComplete(Typewriter* tw) {
     EventArgs_TypewriterLineComplete args;
     args.lineCurrent = tw->textIndex;
     args.lineCount = tw->textCount;
-    EventHandlerCallEvent(tw, EVENT_TYPEWRITER_LINE_COMPLETE, &args);
+    EventHandlerPost(tw, args);
 }
 void TypewriterStart(Typewriter* tw, String* str, i32 strCount) {
     tw->visible = true;
@@ -2321,16 +4242,16 @@ void DialogueOptionsUpdate(void* _dopt) {
         EventArgs_DialogueOptionsSelected args;
         args.count = dopt->count;
         args.index = dopt->index;
-        EventHandlerCallEvent(dopt, EVENT_DIALOGUE_OPTIONS_SELECTED, &args);
+        EventHandlerPost(dopt, args);
     }
 }
 void DialogueOptionsDraw(void* _dopt) {
     DialogueOptions* dopt = (DialogueOptions*)_dopt;
-    if (!dopt->visible) {
+    if (!dopt->visible || dopt->count == 0) {
         return;
     }
 
-    v2* textSize = (v2*)malloc(dopt->count * sizeof(v2));
+    v2* textSize = FrameReserve<v2>(dopt->count);
     v2 boxSize = {0.f, 0.f};
     // TODO: These measurements can be done as preprocessing. No need for the memory allocation every fucking frame
     for (i32 i = 0; i < dopt->count; i++) {
@@ -2374,22 +4295,26 @@ void DialogueOptionsDraw(void* _dopt) {
             dopt->textStyle.charSpacing,
             textTint);
     }
-    free(textSize);
 }
 
 void* DialogueSequenceCreate(MemoryPool* mp) {
-    DialogueSequence* dseq = MemoryReserve<DialogueSequence>(mp);
+    MemoryTagScope tag(mp, MEMORY_TAG_DIALOGUE);
+    DialogueSequence* dseq = GameObjectDataReserve<DialogueSequence>(mp);
     dseq->sectionIndex = 0;
-    dseq->sections = TypeListCreate(MD_TYPE_PTR, mp, 50);
+    dseq->sections = ArenaArrayCreate<DialogueSequenceSection*>(mp, 8);
     TypewriterInit(&dseq->typewriter);
     dseq->typewriter.autoAdvance = true;
     dseq->typewriter.autoHide = false;
     DialogueOptionsInit(&dseq->options);
     DialogueSequenceSetLayout(dseq, DIALOGUE_SEQUENCE_LAYOUT_PLACEHOLDER_BOXLESS);
-    EventHandlerRegisterEvent(EVENT_TYPEWRITER_LINE_COMPLETE, dseq, (EventCallbackSignature)DialogueSequenceHandleTypewriter_TextAdvance);
-    EventHandlerRegisterEvent(EVENT_DIALOGUE_OPTIONS_SELECTED, dseq, (EventCallbackSignature)DialogueSequenceHandleOptions_Selected);
+    dseq->_lineCompleteListener = EventHandlerRegister(dseq, DialogueSequenceHandleTypewriter_TextAdvance, &dseq->typewriter);
+    dseq->_optionSelectedListener = EventHandlerRegister(dseq, DialogueSequenceHandleOptions_Selected, &dseq->options);
     return dseq;
 }
+void DialogueSequenceFree(DialogueSequence* dseq) {
+    EventHandlerUnregisterEvent(dseq->_lineCompleteListener);
+    EventHandlerUnregisterEvent(dseq->_optionSelectedListener);
+}
 void DialogueSequenceSectionStart(DialogueSequence* dseq, i32 ind) {
     DialogueSequenceSection* dss = DialogueSequenceSectionGet(dseq, ind);
     TypewriterStart(&dseq->typewriter, dss->text->data, dss->text->size);
@@ -2437,15 +4362,16 @@ void DialogueSequenceSetLayout(DialogueSequence* dseq, i32 layout) {
     }
 }
 DialogueSequenceSection* DialogueSequenceSectionGet(DialogueSequence* dseq, i32 ind) {
-    return (DialogueSequenceSection*)TypeListGetPtr(dseq->sections, ind);
+    return *ArenaArrayGet(dseq->sections, ind);
 }
 DialogueSequenceSection* DialogueSequenceSectionCreate(i32 textCount, i32 optionCount, MemoryPool* mp) {
+    MemoryTagScope tag(mp, MEMORY_TAG_DIALOGUE);
     DialogueSequenceSection* dss = MemoryReserve<DialogueSequenceSection>(mp);
     dss->text = MemoryReserve<StringList>(mp);
     StringListInit(dss->text, textCount, mp);
     dss->options = MemoryReserve<StringList>(mp);
     StringListInit(dss->options, optionCount, mp);
-    dss->link = TypeListCreate(MD_TYPE_I32, mp);
+    dss->link = ArenaArrayCreate<i32>(mp, optionCount);
     return dss;
 }
 
@@ -2458,7 +4384,7 @@ void DialogueSequenceHandleTypewriter_TextAdvance(DialogueSequence* dseq, EventA
 }
 void DialogueSequenceHandleOptions_Selected(DialogueSequence* dseq, EventArgs_DialogueOptionsSelected* args) {
     DialogueSequenceSection* dss = DialogueSequenceSectionGet(dseq, dseq->sectionIndex);
-    i32 nextSectionIndex = TypeListGetI32(dss->link, args->index);
+    i32 nextSectionIndex = *ArenaArrayGet(dss->link, args->index);
     if (nextSectionIndex == -1) {
         dseq->options.visible = false;
         dseq->typewriter.visible = false;
@@ -2476,7 +4402,13 @@ void HeightmapInit(Heightmap* hm, HeightmapGenerationInfo info) {
     const i32 heightDataWidth = image->width >> resdiv;
     const i32 heightDataHeight = image->height >> resdiv;
 
-    float *heightData = (float*)malloc(heightDataWidth * heightDataHeight * sizeof(float));
+    float *heightData = nullptr;
+    if (info.memoryPool != nullptr) {
+        MemoryTagScope tag(info.memoryPool, MEMORY_TAG_HEIGHTMAP);
+        heightData = MemoryReserveAligned<float>(info.memoryPool, heightDataWidth * heightDataHeight, CACHE_LINE_SIZE);
+    } else {
+        heightData = (float*)malloc(heightDataWidth * heightDataHeight * sizeof(float));
+    }
     byte* data = (byte*)info.image->data;
     i32 dataW = heightDataWidth;
     i32 imgw = image->width;
@@ -2489,6 +4421,7 @@ void HeightmapInit(Heightmap* hm, HeightmapGenerationInfo info) {
     }
 
     hm->heightData = heightData;
+    hm->_memoryPool = info.memoryPool;
     hm->heightDataWidth = heightDataWidth;
     hm->heightDataHeight = heightDataHeight;
     hm->size = info.size;
@@ -2516,21 +4449,389 @@ float HeightmapSampleHeight(Heightmap* hm, float x, float z) {
     return 0.f;
 }
 void HeightmapFree(Heightmap* hm) {
-    free(hm->heightData);
+    if (hm->_memoryPool == nullptr) {
+        free(hm->heightData);
+    }
     memset(hm, NULL, sizeof(Heightmap));
 }
 
 void* InstanceRendererCreate(MemoryPool* mp) {
-    InstanceRenderer* ir = MemoryReserve<InstanceRenderer>(mp);
+    InstanceRenderer* ir = GameObjectDataReserve<InstanceRenderer>(mp);
     ir->transforms = nullptr;
+    ir->chunks = {};
+    ir->impostor = nullptr;
+    ir->impostorMaterial = nullptr;
+    ir->impostorDistance = 0.f;
+    ir->impostorFade = 0.f;
+    ir->_buffer = {};
+    ir->_impostorBuffer = {};
+    ir->_meshLodLocs = {};
+    ir->_impostorLodLocs = {};
+    ir->_impostorFramesLoc = -1;
+    ir->_impostorSizeLoc = -1;
+    ir->_impostorCenterYLoc = -1;
+    ir->_dirtyStart = 0;
+    ir->_dirtyEnd = 0;
     return ir;
 }
+// Creates the instance buffer from the current transforms. Happens on the first draw if not called before,
+// call it again after changing instanceCount, mesh or material
+void InstanceRendererUpload(InstanceRenderer* ir) {
+    InstanceBufferUnload(&ir->_impostorBuffer);
+    InstanceBufferUnload(&ir->_buffer);
+    ir->_dirtyStart = 0;
+    ir->_dirtyEnd = 0;
+    if (ir->transforms == nullptr || ir->instanceCount <= 0) {
+        return;
+    }
+    ir->_buffer = InstanceBufferLoad(ir->mesh, ir->material->shader, ir->transforms, ir->instanceCount, false);
+    if (ir->impostor != nullptr) {
+        ir->_impostorBuffer = InstanceBufferLoadShared(ir->impostor->quad, ir->impostorMaterial->shader, &ir->_buffer);
+    }
+}
+void InstanceRendererMarkDirty(InstanceRenderer* ir, i32 start, i32 count) {
+    if (start < 0 || count <= 0 || start + count > ir->instanceCount) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Range %i+%i is outside of the %i instances", nameof(InstanceRendererMarkDirty), start, count, ir->instanceCount));
+        assert(false);
+        return;
+    }
+    if (ir->_dirtyStart == ir->_dirtyEnd) {
+        ir->_dirtyStart = start;
+        ir->_dirtyEnd = start + count;
+    } else {
+        ir->_dirtyStart = imini(ir->_dirtyStart, start);
+        ir->_dirtyEnd = imaxi(ir->_dirtyEnd, start + count);
+    }
+}
+// Instances further than distance are drawn as the impostor. Over the fade before that both are drawn, dithered into each other.
+// Passing nullptr goes back to drawing the mesh at every distance
+void InstanceRendererSetImpostor(InstanceRenderer* ir, ImpostorAtlas* atlas, Material* material, float distance, float fade) {
+    if (atlas != nullptr && ShaderGetInstanceFormat(material->shader) != ShaderGetInstanceFormat(ir->material->shader)) {
+        TraceLog(LOG_WARNING, TextFormat("%s: The impostor material has to use the same instance format as the mesh", nameof(InstanceRendererSetImpostor)));
+        return;
+    }
+    ir->impostor = atlas;
+    ir->impostorMaterial = material;
+    ir->impostorDistance = distance;
+    ir->impostorFade = fmaxf(fminf(fade, distance), 0.f);
+    if (atlas != nullptr) {
+        ir->_meshLodLocs = _InstanceLodLocationsGet(ir->material->shader);
+        ir->_impostorLodLocs = _InstanceLodLocationsGet(material->shader);
+        ir->_impostorFramesLoc = GetShaderLocation(material->shader, "impostorFrames");
+        ir->_impostorSizeLoc = GetShaderLocation(material->shader, "impostorSize");
+        ir->_impostorCenterYLoc = GetShaderLocation(material->shader, "impostorCenterY");
+    }
+    ir->chunks._cullValid = false;
+    // Rebuilt on the next draw
+    InstanceBufferUnload(&ir->_impostorBuffer);
+    InstanceBufferUnload(&ir->_buffer);
+}
+_InstanceLodLocations _InstanceLodLocationsGet(Shader shader) {
+    _InstanceLodLocations locs = {};
+    locs.origin = GetShaderLocation(shader, "lodOrigin");
+    locs.fadeStart = GetShaderLocation(shader, "lodFadeStart");
+    locs.fadeEnd = GetShaderLocation(shader, "lodFadeEnd");
+    return locs;
+}
+// NOTE: Set on every draw, other materials can share the shader programs
+void _InstanceRendererSetLodUniforms(Shader shader, _InstanceLodLocations locs, v3 origin, float fadeStart, float fadeEnd) {
+    SetShaderValue(shader, locs.origin, &origin.x, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, locs.fadeStart, &fadeStart, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(shader, locs.fadeEnd, &fadeEnd, SHADER_UNIFORM_FLOAT);
+}
 void InstanceRendererDraw3d(InstanceRenderer* is) {
-    DrawMeshInstancedOptimized(is->mesh, *is->material, is->transforms, is->instanceCount);
+    if (is->_buffer.vaoId == 0) {
+        InstanceRendererUpload(is);
+    }
+    if (is->_dirtyStart != is->_dirtyEnd) {
+        InstanceBufferUpdate(&is->_buffer, is->transforms, is->_dirtyStart, is->_dirtyEnd - is->_dirtyStart);
+        is->_dirtyStart = 0;
+        is->_dirtyEnd = 0;
+    }
+    // NOTE: Draw3d runs inside BeginMode3D, so these are the current camera's matrices
+    mat4 view = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+    mat4 cameraTransform = MatrixInvert(view);
+    v3 origin = {cameraTransform.m12, cameraTransform.m13, cameraTransform.m14};
+    const bool impostor = is->impostor != nullptr && is->_impostorBuffer.vaoId != 0;
+    const float fadeEnd = impostor ? is->impostorDistance : 0.f;
+    const float fadeStart = impostor ? is->impostorDistance - is->impostorFade : 0.f;
+    if (impostor) {
+        Shader shader = is->impostorMaterial->shader;
+        float frames = (float)is->impostor->frameCount;
+        _InstanceRendererSetLodUniforms(is->material->shader, is->_meshLodLocs, origin, fadeStart, fadeEnd);
+        _InstanceRendererSetLodUniforms(shader, is->_impostorLodLocs, origin, fadeStart, fadeEnd);
+        SetShaderValue(shader, is->_impostorFramesLoc, &frames, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, is->_impostorSizeLoc, &is->impostor->size, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, is->_impostorCenterYLoc, &is->impostor->centerY, SHADER_UNIFORM_FLOAT);
+    }
+
+    InstanceChunkGrid* grid = &is->chunks;
+    if (grid->count == 0) {
+        DrawMeshInstanceBuffer(is->mesh, *is->material, &is->_buffer, is->instanceCount);
+        if (impostor) {
+            rlDisableBackfaceCulling();
+            DrawMeshInstanceBuffer(is->impostor->quad, *is->impostorMaterial, &is->_impostorBuffer, is->instanceCount);
+            rlEnableBackfaceCulling();
+        }
+    } else {
+        mat4 viewProjection = MatrixMultiply(view, rlGetMatrixProjection());
+        if (!grid->_cullValid || memcmp(&viewProjection, &grid->_cullMatrix, sizeof(mat4)) != 0) {
+            _InstanceChunkGridCull(grid, viewProjection, origin, impostor ? fadeEnd : INFINITY, impostor ? fadeStart : INFINITY);
+        }
+        DrawMeshInstanceBufferRanges(is->mesh, *is->material, &is->_buffer, grid->_visibleRanges, grid->_visibleRangeCount);
+        if (impostor) {
+            // NOTE: Which side of the billboard faces the camera isn't worth keeping track of
+            rlDisableBackfaceCulling();
+            DrawMeshInstanceBufferRanges(is->impostor->quad, *is->impostorMaterial, &is->_impostorBuffer, grid->_impostorRanges, grid->_impostorRangeCount);
+            rlEnableBackfaceCulling();
+        }
+    }
+    if (impostor) {
+        // NOTE: Other materials share the mesh shader. A fade end of 0 turns the crossfade back off for them
+        float fadeOff = 0.f;
+        SetShaderValue(is->material->shader, is->_meshLodLocs.fadeEnd, &fadeOff, SHADER_UNIFORM_FLOAT);
+    }
+}
+void InstanceRendererFree(InstanceRenderer* ir) {
+    InstanceBufferUnload(&ir->_impostorBuffer);
+    InstanceBufferUnload(&ir->_buffer);
+}
+// Sorts the transforms into square cells of chunkSize so InstanceRendererDraw3d can skip the cells outside the view
+void InstanceRendererBuildChunks(InstanceRenderer* ir, float chunkSize, MemoryPool* mp) {
+    ir->chunks = {};
+    if (ir->transforms == nullptr || ir->instanceCount <= 0) {
+        return;
+    }
+    if (chunkSize <= 0.f) {
+        TraceLog(LOG_WARNING, TextFormat("%s: Chunk size has to be positive", nameof(InstanceRendererBuildChunks)));
+        return;
+    }
+    const i32 instanceCount = ir->instanceCount;
+    const INSTANCE_FORMAT format = ShaderGetInstanceFormat(ir->material->shader);
+    const i32 stride = InstanceFormatGetStride(format);
+    float scale;
+    v3 first = InstanceGetPosition(ir->transforms, format, 0, &scale);
+    v2 gridMin = {first.x, first.z};
+    v2 gridMax = gridMin;
+    for (i32 i = 1; i < instanceCount; i++) {
+        v3 position = InstanceGetPosition(ir->transforms, format, i, &scale);
+        gridMin = Vector2Min(gridMin, {position.x, position.z});
+        gridMax = Vector2Max(gridMax, {position.x, position.z});
+    }
+    const i32 gridWidth = (i32)((gridMax.x - gridMin.x) / chunkSize) + 1;
+    const i32 gridHeight = (i32)((gridMax.y - gridMin.y) / chunkSize) + 1;
+    const i32 cellCount = gridWidth * gridHeight;
+
+    ScratchScope scratch(&mdEngine::scratchMemory, false);
+    i32* cellOf = MemoryReserve<i32>(&mdEngine::scratchMemory, instanceCount);
+    i32* cellStarts = MemoryReserve<i32>(&mdEngine::scratchMemory, cellCount + 1);
+    memset(cellStarts, 0, (cellCount + 1) * sizeof(i32));
+    for (i32 i = 0; i < instanceCount; i++) {
+        v3 position = InstanceGetPosition(ir->transforms, format, i, &scale);
+        i32 x = imini((i32)((position.x - gridMin.x) / chunkSize), gridWidth - 1);
+        i32 z = imini((i32)((position.z - gridMin.y) / chunkSize), gridHeight - 1);
+        cellOf[i] = x + z * gridWidth;
+        cellStarts[cellOf[i] + 1]++;
+    }
+    i32 nonEmptyCells = 0;
+    for (i32 c = 0; c < cellCount; c++) {
+        nonEmptyCells += cellStarts[c + 1] > 0;
+        cellStarts[c + 1] += cellStarts[c];
+    }
+    // Counting sort keeps the original order inside a cell
+    byte* sorted = MemoryReserve<byte>(&mdEngine::scratchMemory, (u64)instanceCount * stride);
+    {
+        i32* cursor = MemoryReserve<i32>(&mdEngine::scratchMemory, cellCount);
+        memcpy(cursor, cellStarts, cellCount * sizeof(i32));
+        for (i32 i = 0; i < instanceCount; i++) {
+            memcpy(sorted + (u64)cursor[cellOf[i]]++ * stride, (byte*)ir->transforms + (u64)i * stride, stride);
+        }
+    }
+    memcpy(ir->transforms, sorted, (u64)instanceCount * stride);
+
+    // Rotation and tilt are covered by growing the bounds by the mesh's radius around its origin
+    BoundingBox meshBounds = GetMeshBoundingBox(ir->mesh);
+    float radius = fmaxf(Vector3Length(meshBounds.min), Vector3Length(meshBounds.max));
+
+    InstanceChunkGrid* grid = &ir->chunks;
+    const i32 padded = (nonEmptyCells + 3) & ~3;
+    float** soa[6] = {&grid->centerX, &grid->centerY, &grid->centerZ, &grid->extentX, &grid->extentY, &grid->extentZ};
+    for (i32 i = 0; i < 6; i++) {
+        *soa[i] = MemoryReserveAligned<float>(mp, padded, 16);
+        memset(*soa[i], 0, padded * sizeof(float));
+    }
+    grid->starts = MemoryReserve<i32>(mp, nonEmptyCells);
+    grid->counts = MemoryReserve<i32>(mp, nonEmptyCells);
+    grid->_visibleRanges = MemoryReserve<i32>(mp, nonEmptyCells * 2);
+    grid->_impostorRanges = MemoryReserve<i32>(mp, nonEmptyCells * 2);
+    for (i32 c = 0; c < cellCount; c++) {
+        i32 start = cellStarts[c];
+        i32 count = cellStarts[c + 1] - start;
+        if (count == 0) {
+            continue;
+        }
+        v3 boundsMin = InstanceGetPosition(ir->transforms, format, start, &scale);
+        v3 boundsMax = boundsMin;
+        float scaleMax = scale;
+        for (i32 i = start + 1; i < start + count; i++) {
+            v3 position = InstanceGetPosition(ir->transforms, format, i, &scale);
+            boundsMin = Vector3Min(boundsMin, position);
+            boundsMax = Vector3Max(boundsMax, position);
+            scaleMax = fmaxf(scaleMax, scale);
+        }
+        v3 center = (boundsMin + boundsMax) * 0.5f;
+        v3 extent = (boundsMax - boundsMin) * 0.5f + v3{radius, radius, radius} * scaleMax;
+        i32 ind = grid->count++;
+        grid->centerX[ind] = center.x;
+        grid->centerY[ind] = center.y;
+        grid->centerZ[ind] = center.z;
+        grid->extentX[ind] = extent.x;
+        grid->extentY[ind] = extent.y;
+        grid->extentZ[ind] = extent.z;
+        grid->starts[ind] = start;
+        grid->counts[ind] = count;
+    }
+    if (ir->_buffer.vaoId != 0) {
+        InstanceRendererMarkDirty(ir, 0, instanceCount);
+    }
+}
+void _InstanceRangesAppend(i32* ranges, i32* rangeCount, i32 start, i32 count) {
+    i32 last = *rangeCount - 1;
+    if (last >= 0 && ranges[last * 2] + ranges[last * 2 + 1] == start) {
+        ranges[last * 2 + 1] += count;
+        return;
+    }
+    ranges[*rangeCount * 2] = start;
+    ranges[*rangeCount * 2 + 1] = count;
+    (*rangeCount)++;
+}
+// Tests the cell bounds against the frustum planes, 4 cells at a time, and merges visible neighbours into ranges.
+// Visible cells with any part closer to origin than meshDistance get the mesh, ones reaching past impostorDistance get the impostor
+void _InstanceChunkGridCull(InstanceChunkGrid* grid, mat4 viewProjection, v3 origin, float meshDistance, float impostorDistance) {
+    // Planes from the rows of the clip matrix (Gribb & Hartmann). Inside is a*x + b*y + c*z + d >= 0
+    const mat4 m = viewProjection;
+    const float planes[6][4] = {
+        {m.m3 + m.m0, m.m7 + m.m4, m.m11 + m.m8, m.m15 + m.m12}, // Left
+        {m.m3 - m.m0, m.m7 - m.m4, m.m11 - m.m8, m.m15 - m.m12}, // Right
+        {m.m3 + m.m1, m.m7 + m.m5, m.m11 + m.m9, m.m15 + m.m13}, // Bottom
+        {m.m3 - m.m1, m.m7 - m.m5, m.m11 - m.m9, m.m15 - m.m13}, // Top
+        {m.m3 + m.m2, m.m7 + m.m6, m.m11 + m.m10, m.m15 + m.m14}, // Near
+        {m.m3 - m.m2, m.m7 - m.m6, m.m11 - m.m10, m.m15 - m.m14}, // Far
+    };
+    grid->_visibleRangeCount = 0;
+    grid->_impostorRangeCount = 0;
+    for (i32 c = 0; c < grid->count; c += 4) {
+        __m128 cx = _mm_load_ps(grid->centerX + c);
+        __m128 cy = _mm_load_ps(grid->centerY + c);
+        __m128 cz = _mm_load_ps(grid->centerZ + c);
+        __m128 ex = _mm_load_ps(grid->extentX + c);
+        __m128 ey = _mm_load_ps(grid->extentY + c);
+        __m128 ez = _mm_load_ps(grid->extentZ + c);
+        __m128 inside = _mm_cmpeq_ps(cx, cx);
+        for (i32 p = 0; p < 6; p++) {
+            // Distance of the center plus the extent projected onto the plane normal
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p][0])), _mm_mul_ps(cy, _mm_set1_ps(planes[p][1]))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+            __m128 reach = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(planes[p][0]))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(planes[p][1])))),
+                _mm_mul_ps(ez, _mm_set1_ps(fabsf(planes[p][2]))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        i32 mask = _mm_movemask_ps(inside);
+        for (i32 lane = 0; lane < 4 && c + lane < grid->count; lane++) {
+            if ((mask & (1 << lane)) == 0) {
+                continue;
+            }
+            i32 ind = c + lane;
+            v3 offset = {
+                fabsf(origin.x - grid->centerX[ind]),
+                fabsf(origin.y - grid->centerY[ind]),
+                fabsf(origin.z - grid->centerZ[ind])};
+            v3 extent = {grid->extentX[ind], grid->extentY[ind], grid->extentZ[ind]};
+            float nearest = Vector3Length(Vector3Max(offset - extent, Vector3Zero()));
+            float furthest = Vector3Length(offset + extent);
+            if (nearest < meshDistance) {
+                _InstanceRangesAppend(grid->_visibleRanges, &grid->_visibleRangeCount, grid->starts[ind], grid->counts[ind]);
+            }
+            if (furthest > impostorDistance) {
+                _InstanceRangesAppend(grid->_impostorRanges, &grid->_impostorRangeCount, grid->starts[ind], grid->counts[ind]);
+            }
+        }
+    }
+    grid->_cullMatrix = viewProjection;
+    grid->_cullValid = true;
+}
+
+void InstanceStreamInit(InstanceStream* is, MemoryPool* mp) {
+    is->staging = MemoryReserveAligned<byte>(mp, _MD_INSTANCE_STREAM_CAPACITY, CACHE_LINE_SIZE);
+    is->draws = MemoryReserve<_InstanceStreamDraw>(mp, _MD_INSTANCE_STREAM_DRAWS_MAX);
+    is->vboId = rlLoadVertexBuffer(nullptr, _MD_INSTANCE_STREAM_CAPACITY * _MD_INSTANCE_STREAM_REGIONS, true);
+    is->region = 0;
+    is->size = 0;
+    is->drawCount = 0;
+}
+// Returns where to write the transforms of the queued draw, in the format of the material's shader.
+// They're uploaded and drawn on the next flush
+void* InstanceStreamQueueDraw(InstanceStream* is, Mesh mesh, Material material, i32 instances) {
+    assert(std::this_thread::get_id() == mdEngine::mainThreadId);
+    if (instances <= 0 || is->vboId == 0) {
+        return nullptr;
+    }
+    i32 size = instances * InstanceFormatGetStride(ShaderGetInstanceFormat(material.shader));
+    if (size > _MD_INSTANCE_STREAM_CAPACITY) {
+        TraceLog(LOG_WARNING, TextFormat("%s: %i instances don't fit in the stream", nameof(InstanceStreamQueueDraw), instances));
+        return nullptr;
+    }
+    if (is->size + size > _MD_INSTANCE_STREAM_CAPACITY || is->drawCount == _MD_INSTANCE_STREAM_DRAWS_MAX) {
+        InstanceStreamFlush(is);
+    }
+    _InstanceStreamDraw* draw = &is->draws[is->drawCount++];
+    draw->mesh = mesh;
+    draw->material = material;
+    draw->offset = is->size;
+    draw->count = instances;
+    is->size += size;
+    return is->staging + draw->offset;
+}
+// NOTE: Queued draws use the matrices that are current at the time of the flush, so don't queue them inside rlPushMatrix
+void InstanceStreamFlush(InstanceStream* is) {
+    if (is->drawCount == 0) {
+        return;
+    }
+    i32 regionStart = is->region * _MD_INSTANCE_STREAM_CAPACITY;
+    rlUpdateVertexBuffer(is->vboId, is->staging, is->size, regionStart);
+    for (i32 i = 0; i < is->drawCount; i++) {
+        _InstanceStreamDraw* draw = &is->draws[i];
+        _DrawMeshInstancedBindMaterial(draw->mesh, draw->material);
+        if (!rlEnableVertexArray(draw->mesh.vaoId)) {
+            _DrawMeshInstancedBindMeshAttributes(draw->mesh, draw->material.shader);
+        }
+        rlEnableVertexBuffer(is->vboId);
+        _DrawMeshInstancedSetInstanceAttributes(draw->material.shader, regionStart + draw->offset);
+        _DrawMeshInstancedDraw(draw->mesh, draw->material, draw->count);
+        // NOTE: The attributes are set on the mesh's own vertex array, turn them back off so it still draws without instancing
+        _DrawMeshInstancedDisableInstanceAttributes(draw->material.shader);
+        _DrawMeshInstancedUnbind(draw->material);
+    }
+    is->region = (is->region + 1) % _MD_INSTANCE_STREAM_REGIONS;
+    is->size = 0;
+    is->drawCount = 0;
+}
+void DrawMeshInstancedStreamed(Mesh mesh, Material material, const void* transforms, i32 instances) {
+    if (instances <= 0) {
+        return;
+    }
+    void* dst = InstanceStreamQueueDraw(&mdEngine::instanceStream, mesh, material, instances);
+    if (dst == nullptr) {
+        DrawMeshInstancedOptimized(mesh, material, transforms, instances);
+        return;
+    }
+    memcpy(dst, transforms, instances * InstanceFormatGetStride(ShaderGetInstanceFormat(material.shader)));
 }
 
 void* ModelInstanceCreate(MemoryPool* mp) {
-    ModelInstance* mi = MemoryReserve<ModelInstance>(mp);
+    ModelInstance* mi = GameObjectDataReserve<ModelInstance>(mp);
     mi->tint = WHITE;
     mi->transform = TransformCreate();
     return mi;
@@ -2538,12 +4839,17 @@ void* ModelInstanceCreate(MemoryPool* mp) {
 void ModelInstanceDraw3d(ModelInstance* mi) {
     DrawModelTransform(mi->model, mi->transform.matrix, mi->tint);
 }
+void ModelInstanceDraw3dBatch(ModelInstance* mis, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        DrawModelTransform(mis[i].model, mis[i].transform.matrix, mis[i].tint);
+    }
+}
 void ModelInstanceDrawImGui(ModelInstance* mi) {
     TransformDrawImGui(&mi->transform);
 }
 
 void* MeshInstanceCreate(MemoryPool* mp) {
-    MeshInstance* mi = MemoryReserve<MeshInstance>(mp);
+    MeshInstance* mi = GameObjectDataReserve<MeshInstance>(mp);
     mi->mesh = {};
     mi->material = LoadMaterialDefault();
     mi->tint = WHITE;
@@ -2553,12 +4859,17 @@ void* MeshInstanceCreate(MemoryPool* mp) {
 void MeshInstanceDraw3d(MeshInstance* mi) {
     DrawMesh(mi->mesh, mi->material, mi->transform.matrix);
 }
+void MeshInstanceDraw3dBatch(MeshInstance* mis, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        DrawMesh(mis[i].mesh, mis[i].material, mis[i].transform.matrix);
+    }
+}
 void MeshInstanceDrawImGui(MeshInstance* mi) {
     TransformDrawImGui(&mi->transform);
 }
 
 void* ParticleSystemCreate(MemoryPool* mp) {
-    ParticleSystem* psys = MemoryReserve<ParticleSystem>(mp);
+    ParticleSystem* psys = GameObjectDataReserve<ParticleSystem>(mp);
     psys->_quad = GenMeshPlane(1.f, 1.f, 1, 1);
     psys->_transforms = (mat4*)RL_CALLOC(PARTICLE_SYSTEM_MAX_PARTICLES, sizeof(mat4));
     psys->count = 64;
@@ -2567,26 +4878,46 @@ void* ParticleSystemCreate(MemoryPool* mp) {
             GetRandomValueF(-10.f, 10.f),
             GetRandomValueF(-10.f, 10.f),
             GetRandomValueF(-10.f, 10.f));
+        psys->_center += {psys->_transforms[i].m12, psys->_transforms[i].m13, psys->_transforms[i].m14};
     }
+    psys->_center /= (float)psys->count;
     return psys;
 }
 void ParticleSystemFree(ParticleSystem* psys) {
     UnloadMesh(psys->_quad);
     RL_FREE(psys->_transforms);
 }
-void ParticleSystemUpdate(ParticleSystem* psys) {
-    v3 stepVelocity = psys->velocity * FRAME_TIME;
+void ParticleSystemUpdate(ParticleSystem* psys, float deltaTime) {
+    v3 stepVelocity = psys->velocity * deltaTime;
     mat4 transpose = MatrixTranslate(stepVelocity.x, stepVelocity.y, stepVelocity.z);
     for (i32 i = 0; i < psys->count; i++) {
         psys->_transforms[i] *= transpose;
     }
+    psys->_center += stepVelocity;
+}
+v3 ParticleSystemGetPosition(ParticleSystem* psys) {
+    return psys->_center;
 }
 void ParticleSystemDraw3d(ParticleSystem* psys) {
-    DrawMeshInstanced(psys->_quad, *psys->_material, psys->_transforms, psys->count);
+    void* transforms = InstanceStreamQueueDraw(&mdEngine::instanceStream, psys->_quad, *psys->_material, psys->count);
+    if (transforms == nullptr) {
+        return;
+    }
+    if (ShaderGetInstanceFormat(psys->_material->shader) == INSTANCE_FORMAT_COMPACT) {
+        // NOTE: Particles only ever get translated
+        for (i32 i = 0; i < psys->count; i++) {
+            mat4 transform = psys->_transforms[i];
+            ((InstanceTransformCompact*)transforms)[i] = InstanceTransformCompactCreate({transform.m12, transform.m13, transform.m14}, 0.f, 0.f, 1.f);
+        }
+    } else {
+        for (i32 i = 0; i < psys->count; i++) {
+            ((float16*)transforms)[i] = MatrixToFloatV(psys->_transforms[i]);
+        }
+    }
 }
 
 void* TextureInstanceCreate(MemoryPool* mp) {
-    TextureInstance* ti = MemoryReserve<TextureInstance>(mp);
+    TextureInstance* ti = GameObjectDataReserve<TextureInstance>(mp);
     Texture* tex = &mdEngine::missingTexture;
     ti->shader = &mdEngine::passthroughShader;
     ti->_texture = tex;
@@ -2614,12 +4945,32 @@ void TextureInstanceSetPosition(TextureInstance* ti, v2 position) {
 }
 void TextureInstanceDrawUi(TextureInstance* ti) {
     BeginShaderMode(*ti->shader);
-    DrawTexturePro(*ti->_texture, ti->_drawSource, ti->_drawDestination, ti->origin, ti->_rotation, {255, 255, 255, 128});//ti->tint);
+    _TextureInstanceDrawTexture(ti);
     EndShaderMode();
 }
+// Consecutive instances that share a shader are drawn without switching shader in between
+void TextureInstanceDrawUiBatch(TextureInstance* tis, i32 count) {
+    Shader* shader = nullptr;
+    for (i32 i = 0; i < count; i++) {
+        if (tis[i].shader != shader) {
+            if (shader != nullptr) {
+                EndShaderMode();
+            }
+            shader = tis[i].shader;
+            BeginShaderMode(*shader);
+        }
+        _TextureInstanceDrawTexture(&tis[i]);
+    }
+    if (shader != nullptr) {
+        EndShaderMode();
+    }
+}
+void _TextureInstanceDrawTexture(TextureInstance* ti) {
+    DrawTexturePro(*ti->_texture, ti->_drawSource, ti->_drawDestination, ti->origin, ti->_rotation, {255, 255, 255, 128});//ti->tint);
+}
 
 void* SkyboxCreate(MemoryPool* mp) {
-    Skybox* sb = MemoryReserve<Skybox>(mp);
+    Skybox* sb = GameObjectDataReserve<Skybox>(mp);
     return sb;
 }
 void SkyboxInit(Skybox* sb, Shader* shader, Image* image) {
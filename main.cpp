@@ -57,6 +57,7 @@ struct Cab {
 };
 void* CabCreate(MemoryPool* mp);
 void CabUpdate(Cab* cab);
+void CabUpdateBatch(Cab* cabs, i32 count);
 void CabDraw3d(Cab* cab);
 void CabDrawImGui(Cab* cab);
 v3 CabGetFrontSeatPosition(Cab* cab);
@@ -92,6 +93,7 @@ struct ForestGenerationInfo {
     float randomPositionOffset;
     float randomYDip;
     float randomTiltDegrees;
+    float chunkSize; // Side length of the cells the trees are culled in
     Heightmap* heightmap;
 };
 void InstanceRendererCreate_InitForest(InstanceRenderer* irOut, Image image, ForestGenerationInfo info, Mesh mesh, Material* material, MemoryPool* sceneMemory, MemoryPool* scratchMemory);
@@ -113,6 +115,7 @@ namespace resources {
         SHADER_UNLIT_INSTANCED,
         SHADER_LIT,
         SHADER_LIT_INSTANCED,
+        SHADER_LIT_IMPOSTOR,
         SHADER_LIT_TERRAIN,
         SHADER_SKYBOX,
         SHADER_PASSTHROUGH,
@@ -131,6 +134,7 @@ namespace resources {
         "unlitInstanced.vs", "unlitInstanced.fs",
         "light.vs", "light.fs",
         "lightInstanced.vs", "lightInstanced.fs",
+        "lightImpostor.vs", "lightImpostor.fs",
         "lightTerrain.vs", "lightTerrain.fs",
         "skybox.vs", "skybox.fs",
         "passthrough.vs", "passthrough.fs",
@@ -151,6 +155,7 @@ namespace resources {
         MATERIAL_LIT,
         MATERIAL_LIT_INSTANCED,
         MATERIAL_LIT_INSTANCED_TREE,
+        MATERIAL_LIT_IMPOSTOR_TREE,
         MATERIAL_LIT_TERRAIN,
         MATERIAL_COUNT
     };
@@ -216,6 +221,12 @@ namespace resources {
     };
     Texture2D textures[resources::TEXTURE_COUNT];
 
+    enum GAME_IMPOSTORS {
+        IMPOSTOR_TREE,
+        IMPOSTOR_COUNT
+    };
+    ImpostorAtlas impostors[IMPOSTOR_COUNT];
+
     enum GAME_IMAGES {
         IMAGE_SKYBOX,
         IMAGE_LEVEL0_HEIGHTMAP,
@@ -254,11 +265,6 @@ namespace global {
     Camera2D currentCameraUi = {};
     const i32 screenWidth = 1440;
     const i32 screenHeight = 800;
-    // TODO: Turn this into an array of sorts
-    constexpr i32 GAME_OBJECT_MAX = 1000;
-    // TODO: Move this to scene memory for cache efficiency
-    GameObject gameObjects[GAME_OBJECT_MAX];
-    i32 gameObjectCount;
     struct {
         float falloffDistance = 20.f;
         float luminocity = 1.f;
@@ -277,21 +283,12 @@ namespace debug {
     char instanceableObjectInstanceName[instanceableObjectInstanceNameMaxLength];
     i32 instanceableObjectSelection = -1;
     const char* instanceableObjectNames;
-    TypeList* instanceableObjectIndices;
+    ArenaArray<i32>* instanceableObjectIndices;
     const char* imguiEditorTexturePaths;
 }
 
-// TODO: Make gameObjectCount and gameObjects part of global state
-void MdGameObjectAdd(GameObject* gameObjects, i32* gameObjectCount, GameObject obj) {
-    gameObjects[*gameObjectCount] = obj;
-    (*gameObjectCount)++;
-}
-
 void MdDebugInit() {
-    debug::instanceableObjectIndices = TypeListCreate(
-        MD_TYPE_I32,
-        &mdEngine::engineMemory,
-        _MD_GAME_ENGINE_OBJECT_COUNT_MAX);
+    debug::instanceableObjectIndices = ArenaArrayCreate<i32>(&mdEngine::engineMemory, _MD_GAME_ENGINE_OBJECT_COUNT_MAX);
     {
         StringBuilder sb = StringBuilderCreate(2048, &mdEngine::engineMemory);
         sb.separator = '\0';
@@ -304,7 +301,7 @@ void MdDebugInit() {
                 TraceLog(LOG_WARNING, TextFormat("%s: String builder ran out of memory", nameof(DebugInit)));
                 break;
             } else {
-                TypeListPushBackI32(debug::instanceableObjectIndices, i);
+                ArenaArrayPushBack(debug::instanceableObjectIndices, i);
             }
         }
         debug::instanceableObjectNames = sb.str;
@@ -326,6 +323,10 @@ enum MD_GAME_OBJECTS_CUSTOM {
     OBJECT_CAB = _MD_GAME_ENGINE_OBJECTS_COUNT,
     OBJECT_CAMERA_MANAGER
 };
+enum MD_GAME_OBJECT_ACCESS_CUSTOM : u64 {
+    GAME_OBJECT_ACCESS_CAB = GAME_OBJECT_ACCESS_CUSTOM << 0,
+    GAME_OBJECT_ACCESS_TERRAIN = GAME_OBJECT_ACCESS_CUSTOM << 1
+};
 void MdGameRegisterObjects() {
     GameObjectDefinition def;
     MemoryPool* mp = &mdEngine::engineMemory;
@@ -334,12 +335,20 @@ void MdGameRegisterObjects() {
     def.Draw3d = (GameInstanceEventFunction)CabDraw3d;
     def.DrawImGui = (GameInstanceEventFunction)CabDrawImGui;
     def.Update = (GameInstanceEventFunction)CabUpdate;
+    def.UpdateBatch = (GameInstanceBatchFunction)CabUpdateBatch;
+    def.reads = GAME_OBJECT_ACCESS_INPUT | GAME_OBJECT_ACCESS_SERVICES | GAME_OBJECT_ACCESS_TERRAIN;
+    def.writes = GAME_OBJECT_ACCESS_CAB;
+    def.mainThread = false;
     MdEngineRegisterObject(def, OBJECT_CAB);
 
     def = GameObjectDefinitionCreate("Camera Manager", CameraManagerCreate, mp);
     def.Update = (GameInstanceEventFunction)CameraManagerUpdate;
     def.DrawUi = (GameInstanceEventFunction)CameraManagerDrawUi;
     def.Free = (GameInstanceEventFunction)CameraManagerFree;
+    def.drawOrder = GAME_OBJECT_DRAW_ORDER_OVERLAY;
+    // NOTE: Reads the mouse through raylib, so it stays on the main thread
+    def.reads = GAME_OBJECT_ACCESS_INPUT | GAME_OBJECT_ACCESS_SERVICES | GAME_OBJECT_ACCESS_CAB;
+    def.writes = GAME_OBJECT_ACCESS_CAMERA;
     MdEngineRegisterObject(def, OBJECT_CAMERA_MANAGER);
 }
 
@@ -360,6 +369,8 @@ void LoadGameModels();
 void UnloadGameModels();
 void LoadGameTextures();
 void UnloadGameTextures();
+void LoadGameImpostors();
+void UnloadGameImpostors();
 void LoadGameImages();
 void UnloadGameImages();
 void LoadGameFonts();
@@ -369,7 +380,7 @@ void UnloadGameResources();
 
 void DrawDebug3d();
 void DrawDebugUi();
-void DebugHandleImGui(GameObject* gameObjects, i32* gameObjectCount);
+void DebugHandleImGui();
 
 // TODO: Make game code reloadable
 namespace scenes {
@@ -378,7 +389,7 @@ namespace priest_reachout {
         DialogueSequenceSection* dss = nullptr;
         StringList* text = nullptr;
         StringList* opt = nullptr;
-        TypeList* link = nullptr;
+        ArenaArray<i32>* link = nullptr;
 
         dss = DialogueSequenceSectionCreate(3, 3, mp);
         text = dss->text;
@@ -390,25 +401,25 @@ namespace priest_reachout {
         StringListAdd(opt, "You will");
         StringListAdd(opt, "No");
         StringListAdd(opt, "Repeat that please");
-        TypeListPushBackI32(link, 1);
-        TypeListPushBackI32(link, -1);
-        TypeListPushBackI32(link, 0);
-        TypeListPushBackPtr(dseq->sections, dss);
+        ArenaArrayPushBack(link, 1);
+        ArenaArrayPushBack(link, -1);
+        ArenaArrayPushBack(link, 0);
+        ArenaArrayPushBack(dseq->sections, dss);
 
         dss = DialogueSequenceSectionCreate(1, 0, mp);
         text = dss->text;
         opt = dss->options;
         link = dss->link;
         StringListAdd(text, "I'm glad we agree, truly!");
-        TypeListPushBackI32(link, -1);
-        TypeListPushBackPtr(dseq->sections, dss);
+        ArenaArrayPushBack(link, -1);
+        ArenaArrayPushBack(dseq->sections, dss);
     }
 
     void DialogueSequence_InitPriestHandover(DialogueSequence* dseq, MemoryPool* mp) {
         DialogueSequenceSection* dss = nullptr;
         StringList* text = nullptr;
         StringList* opt = nullptr;
-        TypeList* link = nullptr;
+        ArenaArray<i32>* link = nullptr;
 
         dss = DialogueSequenceSectionCreate(1, 3, mp);
         text = dss->text;
@@ -418,10 +429,10 @@ namespace priest_reachout {
         StringListAdd(opt, "Thank you, father");
         StringListAdd(opt, "(Silently take the money)");
         StringListAdd(opt, "I Expected a bit more");
-        TypeListPushBackI32(link, 1);
-        TypeListPushBackI32(link, 1);
-        TypeListPushBackI32(link, 2);
-        TypeListPushBackPtr(dseq->sections, dss); // 0
+        ArenaArrayPushBack(link, 1);
+        ArenaArrayPushBack(link, 1);
+        ArenaArrayPushBack(link, 2);
+        ArenaArrayPushBack(dseq->sections, dss); // 0
 
         dss = DialogueSequenceSectionCreate(2, 3, mp);
         text = dss->text;
@@ -432,10 +443,10 @@ namespace priest_reachout {
         StringListAdd(opt, "Forget it");
         StringListAdd(opt, "Maybe I will");
         StringListAdd(opt, "I'll think about it");
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackPtr(dseq->sections, dss); // 1
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(dseq->sections, dss); // 1
 
         // TODO: "The priest stares blankly at you through the window"
         dss = DialogueSequenceSectionCreate(3, 3, mp);
@@ -448,10 +459,10 @@ namespace priest_reachout {
         StringListAdd(opt, "Forget it");
         StringListAdd(opt, "Maybe I will");
         StringListAdd(opt, "I'll think about it");
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackI32(link, 3);
-        TypeListPushBackPtr(dseq->sections, dss); // 2
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(link, 3);
+        ArenaArrayPushBack(dseq->sections, dss); // 2
 
         dss = DialogueSequenceSectionCreate(1, 3, mp);
         text = dss->text;
@@ -462,17 +473,17 @@ namespace priest_reachout {
         StringListAdd(opt, "(Take the cross)"); // TODO: Cross get notification
         StringListAdd(opt, "...");
         StringListAdd(opt, "A crucifix?");
-        TypeListPushBackI32(link, 4);
-        TypeListPushBackI32(link, 5);
-        TypeListPushBackI32(link, 5);
-        TypeListPushBackPtr(dseq->sections, dss); // 3
+        ArenaArrayPushBack(link, 4);
+        ArenaArrayPushBack(link, 5);
+        ArenaArrayPushBack(link, 5);
+        ArenaArrayPushBack(dseq->sections, dss); // 3
 
         dss = DialogueSequenceSectionCreate(1, 0, mp);
         text = dss->text;
         opt = dss->options;
         link = dss->link;
         StringListAdd(text, "(Without another word the priest scurries off toward the church)"); // TODO: Back to 3d scene
-        TypeListPushBackPtr(dseq->sections, dss); // 4
+        ArenaArrayPushBack(dseq->sections, dss); // 4
 
         dss = DialogueSequenceSectionCreate(2, 3, mp);
         text = dss->text;
@@ -483,78 +494,72 @@ namespace priest_reachout {
         StringListAdd(opt, "Hey!");
         StringListAdd(opt, "What am I supposed to do with this?");
         StringListAdd(opt, "...");
-        TypeListPushBackI32(link, -1);
-        TypeListPushBackI32(link, -1);
-        TypeListPushBackI32(link, -1);
-        TypeListPushBackPtr(dseq->sections, dss); // 5
+        ArenaArrayPushBack(link, -1);
+        ArenaArrayPushBack(link, -1);
+        ArenaArrayPushBack(link, -1);
+        ArenaArrayPushBack(dseq->sections, dss); // 5
     }
 
-    void TextureInstanceMoon_ScriptInit(GameObject* obj, TextureInstance* ti) {
+    Coroutine TextureInstanceMoon_Script(GameObject* obj, TextureInstance* ti) {
+        i32 time = 0;
+        byte fadeTweenValueStart = 0;
+        byte fadeTweenValueEnd = 255;
         ti->tint.a = 0;
-        InstanceVariablePush("time", 0);
-        InstanceVariablePush("fadeTweenValueStart", (byte)0);
-        InstanceVariablePush("fadeTweenValueEnd", (byte)255);
-
-        Tween t = TweenCreate(
+        Tween fadeTween = TweenCreate(
             &(ti->tint.a),
-            _InstanceVariableGet("fadeTweenValueStart", MD_TYPE_BYTE),
-            _InstanceVariableGet("fadeTweenValueEnd", MD_TYPE_BYTE),
+            &fadeTweenValueStart,
+            &fadeTweenValueEnd,
             MD_TYPE_BYTE,
             2.f);
-        //TweenStart(&t);
-        InstanceVariablePush("fadeTween", t);
-    }
-    void TextureInstanceMoon_ScriptUpdate(GameObject* obj, TextureInstance* ti) {
-        i32 time = InstanceVariableGet<i32>("time");
-        time++;
-        SetShaderValue(
-            *ti->shader,
-            GetShaderLocation(*ti->shader, "time"),
-            &time,
-            SHADER_UNIFORM_INT);
-        InstanceVariableSet("time", time);
-        ShaderColor colorDiffuse = ColorToShaderColor(ti->tint);
-        // TODO: Figure out why I have to pass color manually instead of tint just working
-        SetShaderValue(
-            *ti->shader,
-            GetShaderLocation(*ti->shader, "color"),
-            &colorDiffuse,
-            SHADER_UNIFORM_VEC4);
-
-        Tween t = InstanceVariableGet<Tween>("fadeTween");
-        TweenStep(&t);
-        InstanceVariableSet("fadeTween", t);
+        //TweenStart(&fadeTween);
+        while (true) {
+            co_await NextFrame();
+            time++;
+            SetShaderValue(
+                *ti->shader,
+                GetShaderLocation(*ti->shader, "time"),
+                &time,
+                SHADER_UNIFORM_INT);
+            ShaderColor colorDiffuse = ColorToShaderColor(ti->tint);
+            // TODO: Figure out why I have to pass color manually instead of tint just working
+            SetShaderValue(
+                *ti->shader,
+                GetShaderLocation(*ti->shader, "color"),
+                &colorDiffuse,
+                SHADER_UNIFORM_VEC4);
+
+            TweenStep(&fadeTween);
+        }
     }
-    void Scene(GameObject* go, i32* count) {
+    void Scene() {
         MemoryPool* mp = &mdEngine::sceneMemory;
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_SKYBOX, mp);
-            SkyboxInit((Skybox*)obj.data, &resources::shaders[resources::SHADER_SKYBOX], &resources::images[resources::IMAGE_SKYBOX]);
-            MdGameObjectAdd(go, count, obj);
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_SKYBOX, mp);
+            SkyboxInit((Skybox*)obj->data, &resources::shaders[resources::SHADER_SKYBOX], &resources::images[resources::IMAGE_SKYBOX]);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp);
-            ModelInstance* mi = (ModelInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp);
+            ModelInstance* mi = (ModelInstance*)obj->data;
             mi->model = resources::models[resources::MODEL_TREE];
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_CAB, mp);
-            obj.active = false;
-            Cab* data = (Cab*)obj.data;
-            MdGameObjectAdd(go, count, obj);
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_CAB, mp);
+            obj->active = false;
+            ServiceRegisterObject<Cab>(obj);
         }
         {
             BoundingBox bb = GetMeshBoundingBox(resources::models[resources::MODEL_LEVEL0].meshes[0]);
             v3 level1_position = bb.min;
             v3 level1_size = bb.max - bb.min;
 
+            MemoryTagScope heightmapTag(mp, MEMORY_TAG_HEIGHTMAP);
             Heightmap* hm = MemoryReserve<Heightmap>(mp);
             HeightmapGenerationInfo hgi = {};
             hgi.image = &resources::images[resources::IMAGE_LEVEL0_HEIGHTMAP];
             hgi.resdiv = 0;
             hgi.size = {level1_size.x, level1_size.z};
             hgi.position = level1_position;
+            hgi.memoryPool = mp;
             HeightmapInit(hm, hgi);
 
             ForestGenerationInfo fgi = {};
@@ -566,9 +571,10 @@ namespace priest_reachout {
             fgi.randomYDip = 0.5f;
             fgi.randomPositionOffset = 2.5f;
             fgi.treeChance = 50.f;
+            fgi.chunkSize = 32.f;
 
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_INSTANCE_RENDERER, mp);
-            InstanceRenderer* ir = (InstanceRenderer*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_INSTANCE_RENDERER, mp);
+            InstanceRenderer* ir = (InstanceRenderer*)obj->data;
             InstanceRendererCreate_InitForest(
                 ir,
                 resources::images[resources::IMAGE_LEVEL0_TERRAINMAP],
@@ -577,150 +583,134 @@ namespace priest_reachout {
                 &resources::materials[resources::MATERIAL_LIT_INSTANCED_TREE],
                 mp,
                 &mdEngine::scratchMemory);
-            MdGameObjectAdd(go, count, obj);
+            InstanceRendererSetImpostor(
+                ir,
+                &resources::impostors[resources::IMPOSTOR_TREE],
+                &resources::materials[resources::MATERIAL_LIT_IMPOSTOR_TREE],
+                100.f,
+                15.f);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp);
-            ModelInstance* mi = (ModelInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp);
+            ModelInstance* mi = (ModelInstance*)obj->data;
             mi->model = resources::models[resources::MODEL_LEVEL0];
             mi->model.materials[0] = resources::materials[resources::MATERIAL_LIT_TERRAIN];
             mi->model.materials[0].maps[MATERIAL_MAP_ALBEDO].texture = resources::textures[resources::TEXTURE_LEVEL0_HEIGHTMAP];
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
-            MdGameObjectAdd(go, count, obj);
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_00];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_00_MOON]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            GameObjectAddScript(
-                &obj,
-                (GameObjectScriptFunc)TextureInstanceMoon_ScriptInit,
-                (GameObjectScriptFunc)TextureInstanceMoon_ScriptUpdate);
-            MdGameObjectAdd(go, count, obj);
+            GameObjectStartCoroutine(obj, TextureInstanceMoon_Script);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_DIALOGUE_SEQUENCE, mp);
-            DialogueSequence* dseq = (DialogueSequence*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_DIALOGUE_SEQUENCE, mp);
+            DialogueSequence* dseq = (DialogueSequence*)obj->data;
             //DialogueSequence_InitPriestHandover(dseq, mp);
             //DialogueSequenceSectionStart(dseq, 0);
-            MdGameObjectAdd(go, count, obj);
         }
         return;
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_00];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_00_MOON]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            GameObjectAddScript(
-                &obj,
-                (GameObjectScriptFunc)TextureInstanceMoon_ScriptInit,
-                (GameObjectScriptFunc)TextureInstanceMoon_ScriptUpdate);
-            MdGameObjectAdd(go, count, obj);
+            GameObjectStartCoroutine(obj, TextureInstanceMoon_Script);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_01];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_01_MIDDLE_GROUND]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_02];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_02_FENCE]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_03];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_03_BODY_MASK]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_04];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_04_BODY_DETAIL]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_05];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_05_ARM_MASK]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_06];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_06_ARM_DETAIL]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_07];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_07_CROSS]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
-            TextureInstance* ti = (TextureInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_TEXTURE_INSTANCE, mp);
+            TextureInstance* ti = (TextureInstance*)obj->data;
             ti->shader = &resources::shaders[resources::SHADER_PRIEST_REACHOUT_08];
             TextureInstanceSetTexture(ti, &resources::textures[resources::TEXTURE_PRIEST_REACHOUT_08_FOREGROUND]);
             TextureInstanceSetSize(ti, {(float)global::screenWidth, (float)global::screenHeight});
-            MdGameObjectAdd(go, count, obj);
         }
     }
 }
 namespace model_viewer_scene {
-    void ModelInstanceObject_Init(GameObject* obj, ModelInstance* mi) {
-        i32 shaderType = 0;
-        InstanceVariablePush("shaderType", shaderType);
+    struct ModelInstanceObject_ScriptState {
+        i32 shaderType;
+    };
+    void ModelInstanceObject_Init(GameObject* obj, ModelInstance* mi, ModelInstanceObject_ScriptState* state) {
+        state->shaderType = 0;
     }
-    void ModelInstanceObject_Update(GameObject* obj, ModelInstance* mi) {
-        i32 shaderType = InstanceVariableGet<i32>("shaderType");
+    void ModelInstanceObject_Update(GameObject* obj, ModelInstance* mi, ModelInstanceObject_ScriptState* state) {
         if (InputCheckPressedMod(INPUT_DEBUG_ACCEPT, false, true, false)) {
-            shaderType = shaderType == 0 ? 1 : 0;
-            if (shaderType == 0) {
+            state->shaderType = state->shaderType == 0 ? 1 : 0;
+            if (state->shaderType == 0) {
                 mi->model.materials[0].shader = resources::shaders[resources::SHADER_PASSTHROUGH];
             } else {
                 mi->model.materials[0].shader = resources::shaders[resources::SHADER_LIT];
             }
-            InstanceVariableSet("shaderType", shaderType);
         }
     }
 
-    void Scene(GameObject* go, i32* count) {
+    void Scene() {
         debug::cameraEnabled = true;
         MemoryPool* mp = &mdEngine::sceneMemory;
 
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp, "Model");
-            ModelInstance *mi = (ModelInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp, "Model");
+            ModelInstance *mi = (ModelInstance*)obj->data;
             mi->model = resources::models[resources::MODEL_TREE];
-            GameObjectAddScript(&obj, (GameObjectScriptFunc)ModelInstanceObject_Init, (GameObjectScriptFunc)ModelInstanceObject_Update);
-            MdGameObjectAdd(go, count, obj);
+            GameObjectAddScript(obj, ModelInstanceObject_Init, ModelInstanceObject_Update);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
-            MdGameObjectAdd(go, count, obj);
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
         }
     }
 }
@@ -912,21 +902,19 @@ Mesh DuplicateMeshNonIndexedReconstruct(Mesh src, unsigned int* indices)
     return m;
 }
 namespace mesh_index_removal {
-    void Scene(GameObject* go, i32* count) {
+    void Scene() {
         debug::cameraEnabled = true;
         MemoryPool* mp = &mdEngine::sceneMemory;
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp, "Model");
-            ModelInstance *mi = (ModelInstance*)obj.data;
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_MODEL_INSTANCE, mp, "Model");
+            ModelInstance *mi = (ModelInstance*)obj->data;
             // Model treeModel = resources::models[resources::MODEL_TREE];
             // mi->mesh = DuplicateMeshNonIndexed(treeModel.meshes[0]);
             // mi->material = treeModel.materials[treeModel.meshMaterial[0]];
             mi->model = resources::models[resources::MODEL_LEVEL0];
-            MdGameObjectAdd(go, count, obj);
         }
         {
-            GameObject obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
-            MdGameObjectAdd(go, count, obj);
+            GameObject* obj = MdEngineInstanceGameObject(OBJECT_CAMERA_MANAGER, mp);
         }
     }
 }
@@ -941,20 +929,23 @@ i32 main() {
     DisableCursor();
 
     LoadGameResources();
+    // NOTE: Scratch and scene memory only reserve address space, pages get committed as they're used
     MdEngineInit(
         MEGABYTES(128),
         MEGABYTES(128),
-        MEGABYTES(4),
-        MEGABYTES(4));
+        MEGABYTES(1),
+        MEGABYTES(1),
+        MEGABYTES(16));
     mdEngine::textDrawingStyleDefault.font = resources::fonts[resources::FONT_GAME];
     mdEngine::textDrawingStyleDefault.size = 48;
     MdGameInit();
     MdDebugInit();
 
-    scenes::priest_reachout::Scene(global::gameObjects, &global::gameObjectCount);
-    //scenes::mesh_index_removal::Scene(global::gameObjects, &global::gameObjectCount);
+    scenes::priest_reachout::Scene();
+    //scenes::mesh_index_removal::Scene();
 
     while (!WindowShouldClose()) {
+        MdEngineBeginFrame();
         InputUpdate(&mdEngine::input);
 
         if (InputCheckPressedMod(INPUT_DEBUG_TOGGLE, false, false, false)) {
@@ -965,7 +956,10 @@ i32 main() {
             debug::cursorEnabled = !debug::cursorEnabled;
         }
 
-        GameObjectsUpdate(global::gameObjects, global::gameObjectCount);
+        if (global::currentCamera != nullptr) {
+            GameObjectsSetUpdateOrigin(global::currentCamera->position);
+        }
+        GameObjectsUpdate();
 
         if (global::currentCamera != nullptr) {
             UpdateGameMaterials(global::currentCamera->position);
@@ -977,22 +971,22 @@ i32 main() {
         ClearBackground(BLACK);
         if (global::currentCamera != nullptr) {
             BeginMode3D(*global::currentCamera);
-                GameObjectsDraw3d(global::gameObjects, global::gameObjectCount);
+                GameObjectsDraw3d();
                 if (debug::overlayEnabled) {
                     DrawDebug3d();
                 }
             EndMode3D();
         }
         BeginMode2D(global::currentCameraUi);
-        GameObjectsDrawUi(global::gameObjects, global::gameObjectCount);
+        GameObjectsDrawUi();
         EndMode2D();
         if (debug::overlayEnabled) {
             DrawDebugUi();
             rlImGuiBegin();
             ImGui::SetWindowPos(debug::inspectorPosition);
             ImGui::SetWindowSize(debug::inspectorSize);
-            DebugHandleImGui(global::gameObjects, &global::gameObjectCount);
-            GameObjectsDrawImGui(global::gameObjects, global::gameObjectCount);
+            DebugHandleImGui();
+            GameObjectsDrawImGui();
             rlImGuiEnd();
         }
         if (!debug::cursorEnabled) {
@@ -1001,9 +995,11 @@ i32 main() {
         }
         debug::cursorEnabledPrevious = debug::cursorEnabled;
         EndDrawing();
+        GameObjectsDestroyDespawned();
     }
 
-    GameObjectsFree(global::gameObjects, global::gameObjectCount);
+    GameObjectsFree();
+    JobSystemShutdown();
     MemoryPoolDestroy(&mdEngine::sceneMemory);
     MemoryPoolDestroy(&mdEngine::persistentMemory);
     UnloadGameResources();
@@ -1045,18 +1041,28 @@ void LoadGameMaterials() {
     Material mat;
 
     sh = resources::shaders[resources::SHADER_LIT_INSTANCED];
-    sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instanceTransform");
+    sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instancePosition");
+    sh.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE] = GetShaderLocationAttrib(sh, "instanceRotationScale");
     mat = LoadMaterialDefault();
     mat.shader = sh;
     resources::materials[resources::MATERIAL_LIT_INSTANCED] = mat;
 
     sh = resources::shaders[resources::SHADER_LIT_INSTANCED];
-    sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instanceTransform");
+    sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instancePosition");
+    sh.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE] = GetShaderLocationAttrib(sh, "instanceRotationScale");
     mat = LoadMaterialDefault();
     mat.shader = sh;
     mat.maps[MATERIAL_MAP_ALBEDO].texture = resources::textures[resources::TEXTURE_TREE_MODEL];
     resources::materials[resources::MATERIAL_LIT_INSTANCED_TREE] = mat;
 
+    sh = resources::shaders[resources::SHADER_LIT_IMPOSTOR];
+    sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instancePosition");
+    sh.locs[SHADER_LOC_INSTANCE_ROTATION_SCALE] = GetShaderLocationAttrib(sh, "instanceRotationScale");
+    mat = LoadMaterialDefault();
+    mat.shader = sh;
+    mat.maps[MATERIAL_MAP_ALBEDO].texture = resources::impostors[resources::IMPOSTOR_TREE].target.texture;
+    resources::materials[resources::MATERIAL_LIT_IMPOSTOR_TREE] = mat;
+
     sh = resources::shaders[resources::SHADER_LIT];
     sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocation(sh, "modelMat");
     mat = LoadMaterialDefault();
@@ -1084,6 +1090,7 @@ void UpdateGameMaterials(v3 lightPosition) {
         resources::MATERIAL_LIT,
         resources::MATERIAL_LIT_INSTANCED,
         resources::MATERIAL_LIT_INSTANCED_TREE,
+        resources::MATERIAL_LIT_IMPOSTOR_TREE,
         resources::MATERIAL_LIT_TERRAIN
     };
     for (i32 i = 0; i < sizeof(lightUpdateMaterials) / sizeof(i32); i++) {
@@ -1146,6 +1153,20 @@ void UnloadGameTextures() {
     }
 }
 
+void LoadGameImpostors() {
+    // NOTE: Baked from the model at load, 8 angles are enough for trees that are only ever seen from far away
+    resources::impostors[resources::IMPOSTOR_TREE] = ImpostorAtlasCreate(
+        resources::models[resources::MODEL_TREE].meshes[0],
+        resources::textures[resources::TEXTURE_TREE_MODEL],
+        8,
+        256);
+}
+void UnloadGameImpostors() {
+    for (i32 i = 0; i < resources::IMPOSTOR_COUNT; i++) {
+        ImpostorAtlasUnload(&resources::impostors[i]);
+    }
+}
+
 void LoadGameImages() {
     for (i32 i = 0; i < resources::IMAGE_COUNT; i++) {
         resources::images[i] = LOAD_IMAGE(resources::imagePaths[i]);
@@ -1177,6 +1198,7 @@ void LoadGameResources() {
     LoadGameImages();
     LoadGameModels();
     LoadGameTextures();
+    LoadGameImpostors();
     LoadGameMaterials();
     LoadGameFonts();
 }
@@ -1185,6 +1207,7 @@ void UnloadGameResources() {
     UnloadGameImages();
     UnloadGameModels();
     UnloadGameTextures();
+    UnloadGameImpostors();
     UnloadGameMaterials();
     UnloadGameFonts();
 }
@@ -1195,19 +1218,12 @@ void DrawDebug3d() {
 void DrawDebugUi() {
     DrawCrosshair(global::screenWidth / 2, global::screenHeight / 2, WHITE);
 }
-void DebugHandleImGui(GameObject* gameObjects, i32* gameObjectCount) {
+void DebugHandleImGui() {
     if (ImGui::CollapsingHeader("General info", ImGuiTreeNodeFlags_DefaultOpen)) {
-        // TODO: TextFormat Text expired
-        // TODO: Add remaining memory pools
-        // TODO: Add bar instead of text (or both)
-        ImGui::Text(TextFormat(
-            "Local memory: %ub / %ub",
-            &mdEngine::sceneMemory.location,
-            &mdEngine::sceneMemory.size));
-        ImGui::Text(
-            TextFormat("Global memory: %ub / %ub",
-            &mdEngine::persistentMemory.location,
-            &mdEngine::persistentMemory.size));
+        MdEngineDrawMemoryImGui();
+        if (ImGui::Button("Dump memory stats")) {
+            MdEngineDumpMemoryStats("memory_stats.txt");
+        }
         // TODO: Make sure this works
         if (ImGui::Button("Reload shaders")) {
             UnloadGameShaders();
@@ -1221,9 +1237,12 @@ void DebugHandleImGui(GameObject* gameObjects, i32* gameObjectCount) {
         ImGui::Combo("Objects", &debug::instanceableObjectSelection, debug::instanceableObjectNames);
         ImGui::InputText("Instance name", debug::instanceableObjectInstanceName, debug::instanceableObjectInstanceNameMaxLength);
         if (ImGui::Button("Instance")) {
-            i32 objectIndex = TypeListGetI32(debug::instanceableObjectIndices, debug::instanceableObjectSelection);
-            GameObject obj = MdEngineInstanceGameObject(objectIndex, &mdEngine::sceneMemory);
-            MdGameObjectAdd(gameObjects, gameObjectCount, obj);
+            i32 objectIndex = *ArenaArrayGet(debug::instanceableObjectIndices, debug::instanceableObjectSelection);
+            if (MdEngineCanInstanceGameObject(objectIndex)) {
+                MdEngineInstanceGameObject(objectIndex, &mdEngine::sceneMemory);
+            } else {
+                TraceLog(LOG_WARNING, TextFormat("%s: No room left for another '%s'", nameof(DebugHandleImGui), mdEngine::gameObjectDefinitions[objectIndex].objectName));
+            }
         }
     }
     if (ImGui::CollapsingHeader("Lighting", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -1239,10 +1258,14 @@ void InstanceRendererCreate_InitForest(InstanceRenderer* irOut, Image image, For
         TraceLog(LOG_WARNING, TextFormat("%s: Passed Image isn't valid for creating a forest", nameof(InstanceRendererCreate_InitForest)));
         return; // TODO: Implement renderable default data for when InstanceMeshRenderData creation fails
     }
+    // Every transform gets written before it's read, so the scratch memory doesn't need zeroing
+    ScratchScope scratch(scratchMemory, false);
+    MemoryTagScope scratchTag(scratchMemory, MEMORY_TAG_FOREST);
+    MemoryTagScope sceneTag(sceneMemory, MEMORY_TAG_FOREST);
     const v2 imageSize = {(float)image.width, (float)image.height};
     const i32 treesMax = (i32)ceilf((info.size.x * info.density) * (info.size.y * info.density));
     i32 treeCount = 0;
-    mat4 *transforms = (mat4*)MemoryReserve<mat4>(scratchMemory, treesMax);
+    InstanceTransformCompact *transforms = MemoryReserve<InstanceTransformCompact>(scratchMemory, treesMax);
     v2 pixelIncrF = imageSize / info.size / info.density;
     const byte* imageData = (byte*)image.data;
     for (float x = 0; x < info.size.x; x += 1.f / info.density) {
@@ -1272,14 +1295,14 @@ void InstanceRendererCreate_InitForest(InstanceRenderer* irOut, Image image, For
             float localTreeChance = (float)colorFinal.g / 255.f * 100.f;
             if (GetRandomChanceF(localTreeChance * info.treeChance)) {
                 v3 treePos = v3{x, 0.f, y} + info.position;
-                transforms[treeCount] = MatrixRotateYaw(GetRandomValueF(0.f, PI));
-                transforms[treeCount] *= MatrixRotatePitch(GetRandomValueF(0.f, info.randomTiltDegrees) * DEG2RAD);
+                float yaw = GetRandomValueF(0.f, PI);
+                float tilt = GetRandomValueF(0.f, info.randomTiltDegrees) * DEG2RAD;
                 v3 translate = {
                     treePos.x + GetRandomValueF(-info.randomPositionOffset, info.randomPositionOffset),
                     treePos.y + GetRandomValueF(-info.randomYDip, 0.f) + HeightmapSampleHeight(info.heightmap, treePos.x, treePos.y), // TODO: Sample a heightmap to get a proper vertical tree position
                     treePos.z + GetRandomValueF(-info.randomPositionOffset, info.randomPositionOffset)
                 };
-                transforms[treeCount] *= MatrixTranslate(translate.x, translate.y, translate.z);
+                transforms[treeCount] = InstanceTransformCompactCreate(translate, yaw, tilt, 1.f);
                 treeCount++;
             }
         }
@@ -1294,21 +1317,20 @@ void InstanceRendererCreate_InitForest(InstanceRenderer* irOut, Image image, For
         return;
     }
 
-    float16 *transforms16 = MemoryReserve<float16>(sceneMemory, treeCount);
-    for (i32 i = 0; i < treeCount; i++) {
-        transforms16[i] = MatrixToFloatV(transforms[i]);
-    }
+    // NOTE: The tree material decodes compact transforms, see lightInstanced.vs
+    assert(ShaderGetInstanceFormat(material->shader) == INSTANCE_FORMAT_COMPACT);
+    InstanceTransformCompact *sceneTransforms = MemoryReserveAligned<InstanceTransformCompact>(sceneMemory, treeCount, CACHE_LINE_SIZE);
+    memcpy(sceneTransforms, transforms, treeCount * sizeof(InstanceTransformCompact));
 
     irOut->instanceCount = treeCount;
-    irOut->transforms = transforms16;
+    irOut->transforms = sceneTransforms;
     irOut->mesh = mesh;
     irOut->material = material;
-
-    MemoryPoolClear(scratchMemory);
+    InstanceRendererBuildChunks(irOut, info.chunkSize, sceneMemory);
 }
 
 void* CabCreate(MemoryPool* mp) {
-    Cab* cab = MemoryReserve<Cab>(mp);
+    Cab* cab = GameObjectDataReserve<Cab>(mp);
     cab->model = resources::models[resources::MODEL_CAB];
     cab->frontSeatPosition = {-0.16f, 1.85f, -0.44f};
     cab->verticalOffset = -0.f;
@@ -1327,7 +1349,6 @@ void* CabCreate(MemoryPool* mp) {
     cab->_speed = 0.f;
     cab->_turnAngle = 0.f;
     memset(cab->meshVisible, 1, sizeof(cab->meshVisible));
-    mdEngine::groups["cab"] = (void*)cab;
     return cab;
 }
 void CabUpdate(Cab* cab) {
@@ -1367,7 +1388,7 @@ void CabUpdate(Cab* cab) {
     cab->position.x += horizontalVelocity.x;
     cab->position.z += horizontalVelocity.y;
 
-    Heightmap* hm = (Heightmap*)mdEngine::groups["terrainHeightmap"];
+    Heightmap* hm = ServiceGet<Heightmap>();
     v3 positionBehind = v3{
             cab->position.x - horizontalDirection.x,
             0.f,
@@ -1390,6 +1411,11 @@ void CabUpdate(Cab* cab) {
     cab->_transform *= yawRotationMatrix;
     cab->_transform *= MatrixTranslate(cab->position.x, cab->position.y, cab->position.z);
 }
+void CabUpdateBatch(Cab* cabs, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        CabUpdate(&cabs[i]);
+    }
+}
 void CabDraw3d(Cab* cab) {
     for (i32 i = 0; i < cab->model.meshCount; i++) {
         if (cab->meshVisible[i]) {
@@ -1412,7 +1438,7 @@ v3 CabGetFrontSeatPosition(Cab *cab) {
 }
 
 void* CameraManagerCreate(MemoryPool* mp) {
-    CameraManager* camMan = MemoryReserve<CameraManager>(mp);
+    CameraManager* camMan = GameObjectDataReserve<CameraManager>(mp);
     camMan->playerCamera = CameraGetDefault();
     camMan->debugCamera = {};
     camMan->debugCamera.fovy = 60.f;
@@ -1441,7 +1467,7 @@ void CameraManagerUpdate(CameraManager* camMan) {
         CameraUpdateDebug(&camMan->debugCamera, camMan->debugCameraSpeed);
         global::currentCamera = &camMan->debugCamera;
     } else {
-        Cab* cab = (Cab*)mdEngine::groups["cab"];
+        Cab* cab = ServiceGet<Cab>();
         if (cab != nullptr) {
             CameraUpdateCab(&camMan->playerCamera, cab);
             global::currentCamera = &camMan->playerCamera;
@@ -0,0 +1,31 @@
+#version 330
+in vec2 fragTexCoord;
+in vec3 fragPosition;
+in float fragLight;
+in float fragLodFade;
+
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+uniform vec3 lightAmbientColor;
+
+out vec4 finalColor;
+
+// Same dither as lightInstanced.fs, keeping the pixels the mesh discards
+float ditherThreshold() {
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(gl_FragCoord.xy) % 4;
+    return (bayer[p.x + p.y * 4] + 0.5) / 16.0;
+}
+
+void main() {
+    if (fragLodFade <= ditherThreshold()) {
+        discard;
+    }
+    vec4 img = texture(texture0, fragTexCoord);
+    if (img.a < 0.5) {
+        discard;
+    }
+    vec4 col = img * colDiffuse * vec4(vec3(fragLight), 1.0);
+    col.rgb = mix(lightAmbientColor, col.rgb, pow(fragLight, 2.0));
+    finalColor = vec4(col.rgb, 1.0);
+}
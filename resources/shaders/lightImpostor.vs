@@ -0,0 +1,52 @@
+#version 330
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec3 instancePosition;
+in vec4 instanceRotationScale; // See lightInstanced.vs
+
+uniform mat4 mvp;
+uniform vec3 lightPosition;
+uniform float lightFalloffDistance;
+uniform float lightLuminocity;
+uniform vec3 lodOrigin;
+uniform float lodFadeStart;
+uniform float lodFadeEnd;
+uniform float impostorFrames;
+uniform float impostorSize;
+uniform float impostorCenterY;
+
+out vec2 fragTexCoord;
+out vec3 fragPosition;
+out float fragLight;
+out float fragLodFade;
+
+const float TAU = 6.28318530718;
+
+void main() {
+    float yaw = (instanceRotationScale.x + instanceRotationScale.y * 256.0) * (255.0 / 65536.0) * TAU;
+    float scale = instanceRotationScale.w * (255.0 / 64.0);
+    vec2 toCamera = lodOrigin.xz - instancePosition.xz;
+    vec2 direction = dot(toCamera, toCamera) > 0.0 ? normalize(toCamera) : vec2(0.0, 1.0);
+    // Camera direction in the instance's unrotated space picks the frame it was baked from
+    float cy = cos(yaw);
+    float sy = sin(yaw);
+    vec2 local = vec2(cy * direction.x - sy * direction.y, sy * direction.x + cy * direction.y);
+    float frame = mod(floor(atan(local.x, local.y) / TAU * impostorFrames + 0.5), impostorFrames);
+
+    // The quad is the xz unit plane, stood up and turned around y to face the camera
+    vec3 right = vec3(direction.y, 0.0, -direction.x);
+    float size = impostorSize * scale;
+    vec3 position = instancePosition
+        + right * vertexPosition.x * size
+        + vec3(0.0, impostorCenterY * scale + vertexPosition.z * size, 0.0);
+
+    fragPosition = position;
+    fragLight = clamp(1.0 - distance(fragPosition, lightPosition) / lightFalloffDistance, 0.0, 1.0) * lightLuminocity;
+    fragTexCoord = vec2((frame + vertexTexCoord.x) / impostorFrames, vertexTexCoord.y);
+    fragLodFade = clamp((distance(lodOrigin, instancePosition) - lodFadeStart) / max(lodFadeEnd - lodFadeStart, 0.0001), 0.0, 1.0);
+    gl_Position = mvp * vec4(position, 1.0);
+    if (fragLodFade <= 0.0) {
+        // Fully covered by the mesh
+        gl_Position = vec4(0.0);
+    }
+}
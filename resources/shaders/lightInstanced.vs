@@ -2,20 +2,56 @@
 in vec3 vertexPosition;
 in vec2 vertexTexCoord;
 in vec3 vertexNormal;
-in mat4 instanceTransform;
+in vec3 instancePosition;
+in vec4 instanceRotationScale; // Yaw low byte, yaw high byte, tilt, scale. Normalized, see InstanceTransformCompact
 
 uniform mat4 mvp;
 uniform vec3 lightPosition;
 uniform float lightFalloffDistance;
 uniform float lightLuminocity;
+uniform vec3 lodOrigin;
+uniform float lodFadeStart;
+uniform float lodFadeEnd; // 0 when there's no impostor to fade to
 
 out vec2 fragTexCoord;
 out vec3 fragPosition;
 out float fragLight;
+out float fragLodFade;
+
+const float TAU = 6.28318530718;
+const float HALF_PI = 1.57079632679;
+
+mat4 instanceTransformDecode() {
+    float yaw = (instanceRotationScale.x + instanceRotationScale.y * 256.0) * (255.0 / 65536.0) * TAU;
+    float tilt = instanceRotationScale.z * HALF_PI;
+    float scale = instanceRotationScale.w * (255.0 / 64.0);
+    float cy = cos(yaw);
+    float sy = sin(yaw);
+    float ct = cos(tilt);
+    float st = sin(tilt);
+    // Tilt around z applied after yaw around y
+    mat3 yawMatrix = mat3(cy, 0.0, -sy, 0.0, 1.0, 0.0, sy, 0.0, cy);
+    mat3 tiltMatrix = mat3(ct, st, 0.0, -st, ct, 0.0, 0.0, 0.0, 1.0);
+    mat3 rotation = tiltMatrix * yawMatrix * scale;
+    return mat4(
+        vec4(rotation[0], 0.0),
+        vec4(rotation[1], 0.0),
+        vec4(rotation[2], 0.0),
+        vec4(instancePosition, 1.0));
+}
 
 void main() {
+    mat4 instanceTransform = instanceTransformDecode();
     fragPosition = vec3(instanceTransform * vec4(vertexPosition, 1.0));
     fragLight = clamp(1.0 - distance(fragPosition, lightPosition) / lightFalloffDistance, 0.0, 1.0) * lightLuminocity;
     fragTexCoord = vertexTexCoord;
     gl_Position = mvp * instanceTransform * vec4(vertexPosition, 1.0);
-}
\ No newline at end of file
+    fragLodFade = 0.0;
+    if (lodFadeEnd > 0.0) {
+        fragLodFade = clamp((distance(lodOrigin, instancePosition) - lodFadeStart) / max(lodFadeEnd - lodFadeStart, 0.0001), 0.0, 1.0);
+        if (fragLodFade >= 1.0) {
+            // Fully replaced by the impostor
+            gl_Position = vec4(0.0);
+        }
+    }
+}